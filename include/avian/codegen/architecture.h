@@ -152,6 +152,13 @@ class Architecture {
                                unsigned cSize,
                                OperandMask& cMask) = 0;
 
+  // plans an Assembler::compareAndSwap of the specified size, setting
+  // *thunk to true if the target cannot do it inline
+  virtual void planCompareAndSwap(unsigned size,
+                                  OperandMask& expectedMask,
+                                  OperandMask& newValueMask,
+                                  bool* thunk) = 0;
+
   virtual Assembler* makeAssembler(util::Alloc*, vm::Zone*) = 0;
 
   virtual void acquire() = 0;
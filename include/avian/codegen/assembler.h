@@ -93,6 +93,14 @@ class Assembler {
                      OperandInfo b,
                      OperandInfo c) = 0;
 
+  // atomically replaces the value at dst with newValue if it equals
+  // expected, leaving the value previously at dst in expected either
+  // way
+  virtual void compareAndSwap(unsigned size,
+                              lir::Memory* dst,
+                              lir::RegisterPair* expected,
+                              lir::RegisterPair* newValue) = 0;
+
   virtual void setDestination(uint8_t* dst) = 0;
 
   virtual void write() = 0;
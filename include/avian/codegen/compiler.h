@@ -128,6 +128,20 @@ class Compiler {
                                 ir::Type resultType,
                                 util::Slice<ir::Value*> arguments) = 0;
 
+  // like nativeCall, except the call is only made if the specified
+  // condition holds at runtime (as for condJump).  Otherwise, it is
+  // skipped and the result is the value of fallback, which must not be
+  // null unless resultType is void.
+  virtual ir::Value* guardedNativeCall(lir::TernaryOperation op,
+                                       ir::Value* a,
+                                       ir::Value* b,
+                                       ir::Value* fallback,
+                                       ir::Value* address,
+                                       unsigned flags,
+                                       TraceHandler* traceHandler,
+                                       ir::Type resultType,
+                                       util::Slice<ir::Value*> arguments) = 0;
+
   virtual ir::Value* stackCall(ir::Value* address,
                                unsigned flags,
                                TraceHandler* traceHandler,
@@ -148,6 +162,31 @@ class Compiler {
                            ir::Value* index,
                            intptr_t handler) = 0;
 
+  // sets the byte at cards + index to a non-zero value unless index is
+  // greater than or equal to count
+  virtual void markCard(ir::Value* index,
+                        ir::Value* count,
+                        ir::Value* cards) = 0;
+
+  // atomically replaces the word at base + displacement with newValue
+  // if it equals expected, returning the word previously stored there
+  // either way.  Only valid if Architecture::planCompareAndSwap
+  // reports that no thunk is needed.
+  virtual ir::Value* compareAndSwap(ir::Type type,
+                                    ir::Value* base,
+                                    int displacement,
+                                    ir::Value* expected,
+                                    ir::Value* newValue) = 0;
+
+  // stores src at base + displacement only if the specified condition
+  // holds at runtime (as for condJump)
+  virtual void guardedStore(lir::TernaryOperation op,
+                            ir::Value* a,
+                            ir::Value* b,
+                            ir::Value* src,
+                            ir::Value* base,
+                            int displacement) = 0;
+
   virtual ir::Value* truncateThenExtend(ir::ExtendMode extendMode,
                                         ir::Type extendType,
                                         ir::Type truncateType,
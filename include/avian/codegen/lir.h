@@ -60,7 +60,7 @@ enum BinaryOperation {
   NoBinaryOperation = -1
 };
 
-const unsigned BinaryOperationCount = Absolute + 1;
+const unsigned BinaryOperationCount = ByteSwap + 1;
 
 enum TernaryOperation {
 #define LIR_OP_0(x)
@@ -110,7 +110,8 @@ inline bool isFloatBinaryOp(lir::TernaryOperation op)
 
 inline bool isGeneralUnaryOp(lir::BinaryOperation op)
 {
-  return op == Negate || op == Absolute;
+  return op == Negate || op == Absolute || op == PopCount
+         || op == LeadingZeros || op == ByteSwap;
 }
 
 inline bool isFloatUnaryOp(lir::BinaryOperation op)
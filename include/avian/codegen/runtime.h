@@ -27,6 +27,12 @@ uint64_t divideDouble(uint64_t b, uint64_t a);
 uint64_t moduloDouble(uint64_t b, uint64_t a);
 uint64_t negateDouble(uint64_t a);
 uint64_t squareRootDouble(uint64_t a);
+uint64_t sineDouble(uint64_t a);
+uint64_t cosineDouble(uint64_t a);
+uint64_t tangentDouble(uint64_t a);
+uint64_t exponentDouble(uint64_t a);
+uint64_t logarithmDouble(uint64_t a);
+uint64_t powerDouble(uint64_t b, uint64_t a);
 uint64_t doubleToFloat(int64_t a);
 int64_t doubleToInt(int64_t a);
 int64_t doubleToLong(int64_t a);
@@ -22,6 +22,10 @@ const unsigned TenureThreshold = 3;
 
 const unsigned FixieTenureThreshold = TenureThreshold + 2;
 
+// the heap remembers stores into tenured objects using a table with
+// one byte per 2^LogCardSizeInBytes bytes of the tenured generation:
+const unsigned LogCardSizeInBytes = 9;
+
 class Heap : public avian::util::Allocator {
  public:
   enum CollectionType { MinorCollection, MajorCollection };
@@ -38,21 +42,40 @@ class Heap : public avian::util::Allocator {
     virtual bool visit(unsigned) = 0;
   };
 
+  // Describes the card table covering the tenured generation.  A
+  // reference store into an object whose address lies within count
+  // cards of start must be recorded by setting the byte at
+  // cards[(address - start) >> LogCardSizeInBytes] to a non-zero
+  // value.  Stores into fixed objects outside that range must be
+  // recorded using mark(), and stores into other objects need not be
+  // recorded at all.  The table itself is at a fixed address, but its
+  // fields may change during any collection.
+  class CardTable {
+   public:
+    uintptr_t start;
+    uintptr_t count;
+    uint8_t* cards;
+  };
+
   class Client {
    public:
     virtual void collect(void* context, CollectionType type) = 0;
     virtual void visitRoots(Visitor*) = 0;
     virtual bool isFixed(void*) = 0;
     virtual unsigned sizeInWords(void*) = 0;
-    virtual unsigned copiedSizeInWords(void*) = 0;
-    virtual void copy(void*, void*) = 0;
+
+    // the header argument to the following is the first word of the
+    // object as it was before the collector claimed it, which may
+    // differ from the word currently stored there:
+    virtual unsigned copiedSizeInWords(void*, uintptr_t header) = 0;
+    virtual void copy(void*, void*, uintptr_t header) = 0;
     virtual void walk(void*, Walker*) = 0;
   };
 
   virtual void setClient(Client* client) = 0;
   virtual void setImmortalHeap(uintptr_t* start, unsigned sizeInWords) = 0;
-  virtual unsigned remaining() = 0;
-  virtual unsigned limit() = 0;
+  virtual size_t remaining() = 0;
+  virtual size_t limit() = 0;
   virtual bool limitExceeded(int pendingAllocation = 0) = 0;
   virtual void collect(CollectionType type,
                        unsigned footprint,
@@ -64,6 +87,7 @@ class Heap : public avian::util::Allocator {
   virtual void* allocateImmortalFixed(avian::util::Alloc* allocator,
                                       unsigned sizeInWords,
                                       bool objectMask) = 0;
+  virtual CardTable* cardTable() = 0;
   virtual void mark(void* p, unsigned offset, unsigned count) = 0;
   virtual void pad(void* p) = 0;
   virtual void* follow(void* p) = 0;
@@ -81,7 +105,7 @@ class Heap : public avian::util::Allocator {
   virtual void dispose() = 0;
 };
 
-Heap* makeHeap(System* system, unsigned limit);
+Heap* makeHeap(System* system, size_t limit, unsigned collectorCount = 1);
 
 }  // namespace vm
 
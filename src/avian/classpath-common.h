@@ -58,64 +58,6 @@ object getTrace(Thread* t, unsigned skipCount)
   return v.trace;
 }
 
-bool compatibleArrayTypes(Thread* t UNUSED, GcClass* a, GcClass* b)
-{
-  return a->arrayElementSize() and b->arrayElementSize()
-         and (a == b or (not((a->vmFlags() & PrimitiveFlag)
-                             or (b->vmFlags() & PrimitiveFlag))));
-}
-
-void arrayCopy(Thread* t,
-               object src,
-               int32_t srcOffset,
-               object dst,
-               int32_t dstOffset,
-               int32_t length)
-{
-  if (LIKELY(src and dst)) {
-    if (LIKELY(compatibleArrayTypes(
-            t, objectClass(t, src), objectClass(t, dst)))) {
-      unsigned elementSize = objectClass(t, src)->arrayElementSize();
-
-      if (LIKELY(elementSize)) {
-        intptr_t sl = fieldAtOffset<uintptr_t>(src, BytesPerWord);
-        intptr_t dl = fieldAtOffset<uintptr_t>(dst, BytesPerWord);
-        if (LIKELY(length > 0)) {
-          if (LIKELY(srcOffset >= 0 and srcOffset + length <= sl
-                     and dstOffset >= 0 and dstOffset + length <= dl)) {
-            uint8_t* sbody = &fieldAtOffset<uint8_t>(src, ArrayBody);
-            uint8_t* dbody = &fieldAtOffset<uint8_t>(dst, ArrayBody);
-            if (src == dst) {
-              memmove(dbody + (dstOffset * elementSize),
-                      sbody + (srcOffset * elementSize),
-                      length * elementSize);
-            } else {
-              memcpy(dbody + (dstOffset * elementSize),
-                     sbody + (srcOffset * elementSize),
-                     length * elementSize);
-            }
-
-            if (objectClass(t, dst)->objectMask()) {
-              mark(t, dst, ArrayBody + (dstOffset * BytesPerWord), length);
-            }
-
-            return;
-          } else {
-            throwNew(t, GcIndexOutOfBoundsException::Type);
-          }
-        } else {
-          return;
-        }
-      }
-    }
-  } else {
-    throwNew(t, GcNullPointerException::Type);
-    return;
-  }
-
-  throwNew(t, GcArrayStoreException::Type);
-}
-
 void runOnLoadIfFound(Thread* t, System::Library* library)
 {
   void* p = library->resolve("JNI_OnLoad");
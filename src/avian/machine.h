@@ -155,6 +155,16 @@ const unsigned FixedFootprintThresholdInBytes = ThreadHeapPoolSize
 // to clean them up:
 const unsigned ZombieCollectionThreshold = 16;
 
+// initial number of entries in the thin lock table (must be a power
+// of two):
+const unsigned InitialThinLockCapacity = 256;
+
+// the thin lock table is grown when claiming an entry for a new
+// object would require probing further than this many entries:
+const unsigned ThinLockProbeLimit = 16;
+
+const uintptr_t InflatedLockMark = 1;
+
 enum FieldCode {
   VoidField,
   ByteField,
@@ -193,6 +203,8 @@ const unsigned ContinuationFlag = 1 << 11;
 // method vmFlags:
 const unsigned ClassInitFlag = 1 << 0;
 const unsigned ConstructorFlag = 1 << 1;
+const unsigned OverriddenFlag = 1 << 2;
+const unsigned DevirtualizedFlag = 1 << 3;
 
 #ifndef JNI_VERSION_1_6
 #define JNI_VERSION_1_6 0x00010006
@@ -977,6 +989,36 @@ class Reference {
   bool weak;
 };
 
+// Objects are locked using entries in an open-addressed table keyed
+// by object address, so an uncontended lock needs neither a monitor
+// nor a hash map lookup.  The owner field holds either the owning
+// thread (or zero if the object is unlocked), in which case depth
+// counts recursive acquisitions, or, once the lock has been inflated
+// due to contention or a call to wait, the object's GcMonitor tagged
+// with InflatedLockMark.  Entries are only added between collections;
+// each collection drops unlocked and unreachable ones and rehashes
+// the rest.
+//
+// Depth does not count the first acquisition, so compiled code can
+// take or release an outermost hold inline with a single
+// compare-and-swap of owner.
+class ThinLock {
+ public:
+  object target;
+  uintptr_t owner;
+  uintptr_t depth;
+};
+
+// Describes the thin lock table, whose entry for an object is found
+// by probing from index thinLockHash(object) & mask.  The descriptor
+// is at a fixed address so compiled code may cache a pointer to it,
+// but its fields may change whenever the VM is in an exclusive state.
+class ThinLockTable {
+ public:
+  ThinLock* locks;
+  uintptr_t mask;
+};
+
 class Classpath;
 
 class Gc {
@@ -1040,6 +1082,7 @@ class Machine {
   System* system;
   Heap::Client* heapClient;
   Heap* heap;
+  Heap::CardTable* cardTable;
   Finder* bootFinder;
   Finder* appFinder;
   Processor* processor;
@@ -1053,7 +1096,6 @@ class Machine {
   const char** arguments;
   unsigned argumentCount;
   unsigned threadCount;
-  unsigned activeCount;
   unsigned liveCount;
   unsigned daemonCount;
   unsigned fixedFootprint;
@@ -1074,6 +1116,8 @@ class Machine {
   GcFinalizer* finalizeQueue;
   GcJreference* weakReferences;
   GcJreference* tenuredWeakReferences;
+  ThinLockTable thinLocks;
+  ThinLock* spareThinLocks;
   bool unsafe;
   bool collecting;
   bool triedBuiltinOnLoad;
@@ -1141,7 +1185,8 @@ class Thread {
     ActiveFlag = 1 << 5,
     SystemFlag = 1 << 6,
     JoinFlag = 1 << 7,
-    TryNativeFlag = 1 << 8
+    TryNativeFlag = 1 << 8,
+    SafePointFlag = 1 << 9
   };
 
   class Protector {
@@ -1361,7 +1406,8 @@ class Thread {
   uintptr_t backupHeap[ThreadBackupHeapSizeInWords];
   unsigned backupHeapIndex;
 
- private:
+  // public only so its offset may be checked against
+  // TARGET_THREAD_FLAGS; use getFlags, setFlag, and clearFlag instead:
   unsigned flags;
 };
 
@@ -1666,12 +1712,19 @@ inline object allocate(Thread* t, unsigned sizeInBytes, bool objectMask)
 
 inline void mark(Thread* t, object o, unsigned offset, unsigned count)
 {
-  t->m->heap->mark(o, offset / BytesPerWord, count);
+  Heap::CardTable* table = t->m->cardTable;
+  uintptr_t i = (reinterpret_cast<uintptr_t>(o) - table->start)
+                >> LogCardSizeInBytes;
+  if (LIKELY(i < table->count)) {
+    table->cards[i] = 1;
+  } else if ((alias(o, 0) & (~PointerMask)) == FixedMark) {
+    t->m->heap->mark(o, offset / BytesPerWord, count);
+  }
 }
 
 inline void mark(Thread* t, object o, unsigned offset)
 {
-  t->m->heap->mark(o, offset / BytesPerWord, 1);
+  mark(t, o, offset, 1);
 }
 
 inline void setField(Thread* t, object target, unsigned offset, object value)
@@ -2473,6 +2526,13 @@ inline object makeObjectArray(Thread* t, unsigned count)
   return makeObjectArray(t, type(t, GcJobject::Type), count);
 }
 
+void arrayCopy(Thread* t,
+               object src,
+               int32_t srcOffset,
+               object dst,
+               int32_t dstOffset,
+               int32_t length);
+
 object findFieldInClass(Thread* t,
                         GcClass* class_,
                         GcByteArray* name,
@@ -2692,6 +2752,76 @@ inline GcMethod* findVirtualMethod(Thread* t, GcMethod* method, GcClass* class_)
       t, cast<GcArray>(t, class_->virtualTable())->body()[method->offset()]);
 }
 
+// number of buckets in the interface dispatch cache (must be a power
+// of two):
+const unsigned InterfaceDispatchCacheSize = 256;
+
+inline unsigned interfaceDispatchHash(GcClass* class_, GcClass* interface)
+{
+  uintptr_t h = reinterpret_cast<uintptr_t>(class_)
+                ^ (reinterpret_cast<uintptr_t>(interface) >> 4);
+  return (h ^ (h >> 12)) >> 3;
+}
+
+// Returns the itable entry (a vtable of methods indexed by interface
+// method offset) of the specified class for the specified interface.
+//
+// Since an itable is searched linearly, we first consult a machine-
+// wide cache whose buckets each hold an immutable triple of class,
+// interface, and itable entry.  Buckets are only ever replaced
+// wholesale, so readers need no lock, and a miss simply replaces
+// whatever the bucket held.  The cache is cleared at each collection
+// (see doCollect), since its entries are keyed by address and would
+// otherwise keep their classes and class loaders reachable.
+inline GcArray* findInterfaceVtable(Thread* t,
+                                    GcClass* class_,
+                                    GcClass* interface)
+{
+  unsigned index = interfaceDispatchHash(class_, interface)
+                   & (InterfaceDispatchCacheSize - 1);
+
+  GcArray* cache = roots(t)->interfaceDispatchCache();
+  if (LIKELY(cache)) {
+    GcTriple* entry = cast<GcTriple>(t, cache->body()[index]);
+
+    if (entry and entry->first() == class_ and entry->second() == interface) {
+      return cast<GcArray>(t, entry->third());
+    }
+  }
+
+  GcArray* itable = cast<GcArray>(t, class_->interfaceTable());
+  for (unsigned i = 0; i < itable->length(); i += 2) {
+    if (itable->body()[i] == interface) {
+      GcArray* vtable = cast<GcArray>(t, itable->body()[i + 1]);
+      PROTECT(t, vtable);
+
+      GcTriple* entry = makeTriple(t, class_, interface, vtable);
+      PROTECT(t, entry);
+
+      if (cache == 0) {
+        cache = makeArray(t, InterfaceDispatchCacheSize);
+        roots(t)->setInterfaceDispatchCache(t, cache);
+      }
+
+      // make sure the triple is fully initialized before another
+      // thread can see it:
+      storeStoreMemoryBarrier();
+
+      // the index computed above may be stale if allocating the triple
+      // or cache caused a collection:
+      roots(t)->interfaceDispatchCache()->setBodyElement(
+          t,
+          interfaceDispatchHash(cast<GcClass>(t, entry->first()),
+                                cast<GcClass>(t, entry->second()))
+          & (InterfaceDispatchCacheSize - 1),
+          entry);
+
+      return vtable;
+    }
+  }
+  abort(t);
+}
+
 inline GcMethod* findInterfaceMethod(Thread* t,
                                      GcMethod* method,
                                      GcClass* class_)
@@ -2703,15 +2833,12 @@ inline GcMethod* findInterfaceMethod(Thread* t,
     resolveSystemClass(t, roots(t)->bootLoader(), class_->name());
   }
 
-  GcClass* interface = method->class_();
-  GcArray* itable = cast<GcArray>(t, class_->interfaceTable());
-  for (unsigned i = 0; i < itable->length(); i += 2) {
-    if (itable->body()[i] == interface) {
-      return cast<GcMethod>(
-          t, cast<GcArray>(t, itable->body()[i + 1])->body()[method->offset()]);
-    }
-  }
-  abort(t);
+  PROTECT(t, method);
+
+  return cast<GcMethod>(
+      t,
+      findInterfaceVtable(t, class_, method->class_())
+          ->body()[method->offset()]);
 }
 
 inline unsigned objectArrayLength(Thread* t UNUSED, object array)
@@ -3084,8 +3211,77 @@ class ObjectMonitorResource {
   Thread::SingleProtector protector;
 };
 
+inline uintptr_t thinLockHash(object o)
+{
+  return (reinterpret_cast<uintptr_t>(o) / BytesPerWord) * 0x9E3779B1;
+}
+
+// Returns the thin lock entry for the specified object, or zero if
+// there is none.  If claim is true, an entry is added if necessary
+// unless the table is too full, in which case zero is returned and
+// the caller should grow the table using growThinLocks.
+inline ThinLock* findThinLock(Thread* t, object o, bool claim)
+{
+  ThinLock* locks = t->m->thinLocks.locks;
+  uintptr_t mask = t->m->thinLocks.mask;
+  uintptr_t index = thinLockHash(o);
+
+  for (uintptr_t i = 0; i <= mask; ++i) {
+    ThinLock* l = locks + ((index + i) & mask);
+    object target = l->target;
+
+    if (target == 0) {
+      if (not(claim and i < ThinLockProbeLimit)) {
+        return 0;
+      } else if (atomicCompareAndSwap(reinterpret_cast<uintptr_t*>(&l->target),
+                                      0,
+                                      reinterpret_cast<uintptr_t>(o))) {
+        return l;
+      }
+
+      // another thread claimed this entry first
+      target = l->target;
+    }
+
+    if (target == o) {
+      return l;
+    }
+  }
+
+  return 0;
+}
+
+void growThinLocks(Thread* t, uintptr_t mask);
+
+inline GcMonitor* inflatedMonitor(Thread* t, ThinLock* l)
+{
+  assertT(t, l->owner & InflatedLockMark);
+
+  GcMonitor* m = reinterpret_cast<GcMonitor*>(l->owner & ~InflatedLockMark);
+
+  if (m->owner() == t and m->depth() == 0) {
+    // another thread inflated the lock while we held it, so we adopt
+    // the recursion count we accumulated before that:
+    m->depth() = l->depth + 1;
+  }
+
+  return m;
+}
+
 GcMonitor* objectMonitor(Thread* t, object o, bool createNew);
 
+inline bool holdsLock(Thread* t, object o)
+{
+  ThinLock* l = findThinLock(t, o, false);
+  if (l == 0) {
+    return false;
+  } else if (l->owner & InflatedLockMark) {
+    return inflatedMonitor(t, l)->owner() == t;
+  } else {
+    return l->owner == reinterpret_cast<uintptr_t>(t);
+  }
+}
+
 inline void acquire(Thread* t, object o)
 {
   unsigned hash;
@@ -3093,13 +3289,23 @@ inline void acquire(Thread* t, object o)
     hash = objectHash(t, o);
   }
 
-  GcMonitor* m = objectMonitor(t, o, true);
+  ThinLock* l = findThinLock(t, o, true);
 
   if (DebugMonitors) {
-    fprintf(stderr, "thread %p acquires %p for %x\n", t, m, hash);
+    fprintf(stderr, "thread %p acquires %p for %x\n", t, l, hash);
+  }
+
+  if (l) {
+    if (l->owner == reinterpret_cast<uintptr_t>(t)) {
+      ++l->depth;
+      return;
+    } else if (atomicCompareAndSwap(
+                   &l->owner, 0, reinterpret_cast<uintptr_t>(t))) {
+      return;
+    }
   }
 
-  monitorAcquire(t, m);
+  monitorAcquire(t, objectMonitor(t, o, true));
 }
 
 inline void release(Thread* t, object o)
@@ -3109,10 +3315,26 @@ inline void release(Thread* t, object o)
     hash = objectHash(t, o);
   }
 
-  GcMonitor* m = objectMonitor(t, o, false);
+  ThinLock* l = findThinLock(t, o, false);
 
   if (DebugMonitors) {
-    fprintf(stderr, "thread %p releases %p for %x\n", t, m, hash);
+    fprintf(stderr, "thread %p releases %p for %x\n", t, l, hash);
+  }
+
+  if (l and l->owner == reinterpret_cast<uintptr_t>(t)) {
+    if (l->depth) {
+      --l->depth;
+      return;
+    } else if (atomicCompareAndSwap(
+                   &l->owner, reinterpret_cast<uintptr_t>(t), 0)) {
+      return;
+    }
+  }
+
+  GcMonitor* m = objectMonitor(t, o, false);
+
+  if (m == 0 or m->owner() != t) {
+    throwNew(t, GcIllegalMonitorStateException::Type);
   }
 
   monitorRelease(t, m);
@@ -3125,7 +3347,7 @@ inline void wait(Thread* t, object o, int64_t milliseconds)
     hash = objectHash(t, o);
   }
 
-  GcMonitor* m = objectMonitor(t, o, false);
+  GcMonitor* m = holdsLock(t, o) ? objectMonitor(t, o, true) : 0;
 
   if (DebugMonitors) {
     fprintf(stderr,
@@ -3136,7 +3358,7 @@ inline void wait(Thread* t, object o, int64_t milliseconds)
             hash);
   }
 
-  if (m and m->owner() == t) {
+  if (m) {
     PROTECT(t, m);
 
     bool interrupted = monitorWait(t, m, milliseconds);
@@ -3173,8 +3395,11 @@ inline void notify(Thread* t, object o)
     fprintf(stderr, "thread %p notifies on %p for %x\n", t, m, hash);
   }
 
-  if (m and m->owner() == t) {
-    monitorNotify(t, m);
+  if (holdsLock(t, o)) {
+    // nobody can be waiting on a lock which has not been inflated
+    if (m) {
+      monitorNotify(t, m);
+    }
   } else {
     throwNew(t, GcIllegalMonitorStateException::Type);
   }
@@ -3192,8 +3417,10 @@ inline void notifyAll(Thread* t, object o)
             objectHash(t, o));
   }
 
-  if (m and m->owner() == t) {
-    monitorNotifyAll(t, m);
+  if (holdsLock(t, o)) {
+    if (m) {
+      monitorNotifyAll(t, m);
+    }
   } else {
     throwNew(t, GcIllegalMonitorStateException::Type);
   }
@@ -115,6 +115,10 @@ class Processor {
 
   virtual void initVtable(Thread* t, GcClass* c) = 0;
 
+  // called when a class is loaded which overrides the specified
+  // virtual method for the first time:
+  virtual void methodOverridden(Thread* t, GcMethod* method) = 0;
+
   virtual void visitObjects(Thread* t, Heap::Visitor* v) = 0;
 
   virtual void walkStack(Thread* t, StackVisitor* v) = 0;
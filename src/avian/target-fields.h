@@ -15,6 +15,9 @@
 #if (TARGET_BYTES_PER_WORD == 8)
 
 #define TARGET_THREAD_EXCEPTION 80
+#define TARGET_THREAD_HEAPINDEX 88
+#define TARGET_THREAD_HEAP 160
+#define TARGET_THREAD_FLAGS 2220
 #define TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT 2264
 #define TARGET_THREAD_EXCEPTIONOFFSET 2272
 #define TARGET_THREAD_EXCEPTIONHANDLER 2280
@@ -32,10 +35,15 @@
 #define TARGET_THREAD_THUNKTABLE 2328
 #define TARGET_THREAD_DYNAMICTABLE 2336
 #define TARGET_THREAD_STACKLIMIT 2384
+#define TARGET_THREAD_CARDTABLE 2392
+#define TARGET_THREAD_THINLOCKTABLE 2400
 
 #elif(TARGET_BYTES_PER_WORD == 4)
 
 #define TARGET_THREAD_EXCEPTION 44
+#define TARGET_THREAD_HEAPINDEX 48
+#define TARGET_THREAD_HEAP 88
+#define TARGET_THREAD_FLAGS 2144
 #define TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT 2168
 #define TARGET_THREAD_EXCEPTIONOFFSET 2172
 #define TARGET_THREAD_EXCEPTIONHANDLER 2176
@@ -53,6 +61,8 @@
 #define TARGET_THREAD_THUNKTABLE 2200
 #define TARGET_THREAD_DYNAMICTABLE 2204
 #define TARGET_THREAD_STACKLIMIT 2228
+#define TARGET_THREAD_CARDTABLE 2232
+#define TARGET_THREAD_THINLOCKTABLE 2236
 
 #else
 #error
@@ -1026,10 +1026,7 @@ extern "C" AVIAN_EXPORT int64_t JNICALL
              "VMThread.holdsLock may only be called on current thread");
   }
 
-  GcMonitor* m
-      = objectMonitor(t, reinterpret_cast<object>(arguments[1]), false);
-
-  return m and m->owner() == t;
+  return holdsLock(t, reinterpret_cast<object>(arguments[1]));
 }
 
 extern "C" AVIAN_EXPORT void JNICALL
@@ -609,10 +609,7 @@ extern "C" AVIAN_EXPORT int64_t JNICALL
 extern "C" AVIAN_EXPORT int64_t JNICALL
     Avian_java_lang_Thread_holdsLock(Thread* t, object, uintptr_t* arguments)
 {
-  GcMonitor* m
-      = objectMonitor(t, reinterpret_cast<object>(arguments[0]), false);
-
-  return m and m->owner() == t;
+  return holdsLock(t, reinterpret_cast<object>(arguments[0]));
 }
 
 extern "C" AVIAN_EXPORT void JNICALL
@@ -3833,10 +3833,7 @@ extern "C" AVIAN_EXPORT jboolean JNICALL
 
 uint64_t jvmHoldsLock(Thread* t, uintptr_t* arguments)
 {
-  GcMonitor* m
-      = objectMonitor(t, *reinterpret_cast<jobject>(arguments[0]), false);
-
-  return m and m->owner() == t;
+  return holdsLock(t, *reinterpret_cast<jobject>(arguments[0]));
 }
 
 extern "C" AVIAN_EXPORT jboolean JNICALL
@@ -2237,6 +2237,99 @@ class Client : public Assembler::Client {
   Context* c;
 };
 
+// Returns true and stores the constant value of v in *value if v
+// is a constant known at this point in compilation.  A value which
+// has been pushed on the stack or stored in a local may be merged with
+// other values at a junction not yet reached, so we only consider
+// values which have never had a home.
+bool constantValue(Context* c, Value* v, int64_t* value)
+{
+  if (v->home >= 0) {
+    return false;
+  }
+
+  ConstantSite* s = findConstantSite(c, v);
+  if (s and s->value->resolved()) {
+    *value = s->value->value();
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// Evaluates (b op a) at compile time if both are resolved constants
+// and the result fits in a word, returning true and storing the
+// result in *result if so.  Division and remainder are left alone
+// so that a zero divisor still traps at runtime.
+bool foldConstants(Context* c,
+                   lir::TernaryOperation op,
+                   ir::Type type,
+                   Value* a,
+                   Value* b,
+                   int64_t* result)
+{
+  unsigned size = type.size(c->targetInfo);
+  int64_t av;
+  int64_t bv;
+  if (type.flavor() != ir::Type::Integer
+      or (size != 4 and size != 8) or size > c->targetInfo.pointerSize
+      or not constantValue(c, a, &av) or not constantValue(c, b, &bv)) {
+    return false;
+  }
+
+  // compute using unsigned arithmetic so that overflow wraps instead
+  // of being undefined:
+  uint64_t x = bv;
+  uint64_t y = av;
+  unsigned shift = av & ((size * 8) - 1);
+  uint64_t r;
+
+  switch (op) {
+  case lir::Add:
+    r = x + y;
+    break;
+
+  case lir::Subtract:
+    r = x - y;
+    break;
+
+  case lir::Multiply:
+    r = x * y;
+    break;
+
+  case lir::And:
+    r = x & y;
+    break;
+
+  case lir::Or:
+    r = x | y;
+    break;
+
+  case lir::Xor:
+    r = x ^ y;
+    break;
+
+  case lir::ShiftLeft:
+    r = x << shift;
+    break;
+
+  case lir::ShiftRight:
+    r = size == 4 ? static_cast<uint64_t>(static_cast<int32_t>(x) >> shift)
+                  : static_cast<uint64_t>(bv >> shift);
+    break;
+
+  case lir::UnsignedShiftRight:
+    r = size == 4 ? static_cast<uint32_t>(x) >> shift : x >> shift;
+    break;
+
+  default:
+    return false;
+  }
+
+  *result = size == 4 ? static_cast<int32_t>(r) : static_cast<int64_t>(r);
+  return true;
+}
+
 class MyCompiler : public Compiler {
  public:
   MyCompiler(System* s,
@@ -2535,6 +2628,51 @@ class MyCompiler : public Compiler {
                                 TraceHandler* traceHandler,
                                 ir::Type resultType,
                                 util::Slice<ir::Value*> arguments)
+  {
+    return nativeCall(lir::NoTernaryOperation,
+                      0,
+                      0,
+                      0,
+                      address,
+                      flags,
+                      traceHandler,
+                      resultType,
+                      arguments);
+  }
+
+  virtual ir::Value* guardedNativeCall(lir::TernaryOperation op,
+                                       ir::Value* a,
+                                       ir::Value* b,
+                                       ir::Value* fallback,
+                                       ir::Value* address,
+                                       unsigned flags,
+                                       TraceHandler* traceHandler,
+                                       ir::Type resultType,
+                                       util::Slice<ir::Value*> arguments)
+  {
+    assertT(&c, isGeneralValue(a) and isGeneralValue(b));
+    assertT(&c, fallback or resultType == ir::Type::void_());
+
+    return nativeCall(op,
+                      static_cast<Value*>(a),
+                      static_cast<Value*>(b),
+                      static_cast<Value*>(fallback),
+                      address,
+                      flags,
+                      traceHandler,
+                      resultType,
+                      arguments);
+  }
+
+  ir::Value* nativeCall(lir::TernaryOperation guardOp,
+                        Value* guardFirst,
+                        Value* guardSecond,
+                        Value* fallback,
+                        ir::Value* address,
+                        unsigned flags,
+                        TraceHandler* traceHandler,
+                        ir::Type resultType,
+                        util::Slice<ir::Value*> arguments)
   {
     bool bigEndian = c.arch->bigEndian();
 
@@ -2567,7 +2705,11 @@ class MyCompiler : public Compiler {
                flags,
                traceHandler,
                result,
-               util::Slice<ir::Value*>(RUNTIME_ARRAY_BODY(args), index));
+               util::Slice<ir::Value*>(RUNTIME_ARRAY_BODY(args), index),
+               guardOp,
+               guardFirst,
+               guardSecond,
+               fallback);
 
     return result;
   }
@@ -2721,6 +2863,52 @@ class MyCompiler : public Compiler {
                       handler);
   }
 
+  virtual void markCard(ir::Value* index, ir::Value* count, ir::Value* cards)
+  {
+    appendCardMark(&c,
+                   static_cast<Value*>(index),
+                   static_cast<Value*>(count),
+                   static_cast<Value*>(cards));
+  }
+
+  virtual ir::Value* compareAndSwap(ir::Type type,
+                                    ir::Value* base,
+                                    int displacement,
+                                    ir::Value* expected,
+                                    ir::Value* newValue)
+  {
+    assertT(&c, isGeneralValue(expected) and isGeneralValue(newValue));
+    assertT(&c, type.size(c.targetInfo) <= c.targetInfo.pointerSize);
+
+    Value* result = value(&c, type);
+    appendCompareAndSwap(&c,
+                         static_cast<Value*>(base),
+                         displacement,
+                         static_cast<Value*>(expected),
+                         static_cast<Value*>(newValue),
+                         result);
+    return result;
+  }
+
+  virtual void guardedStore(lir::TernaryOperation op,
+                            ir::Value* a,
+                            ir::Value* b,
+                            ir::Value* src,
+                            ir::Value* base,
+                            int displacement)
+  {
+    assertT(&c, isGeneralBranch(op));
+    assertT(&c, src->type.size(c.targetInfo) <= c.targetInfo.pointerSize);
+
+    appendGuardedStore(&c,
+                       op,
+                       static_cast<Value*>(a),
+                       static_cast<Value*>(b),
+                       static_cast<Value*>(src),
+                       static_cast<Value*>(base),
+                       displacement);
+  }
+
   virtual ir::Value* truncate(ir::Type type, ir::Value* src)
   {
     assertT(&c, src->type.flavor() == type.flavor());
@@ -2825,6 +3013,17 @@ class MyCompiler : public Compiler {
             (isGeneralBinaryOp(op) and isGeneralValue(a) and isGeneralValue(b))
             or (isFloatBinaryOp(op) and isFloatValue(a) and isFloatValue(b)));
 
+    int64_t folded;
+    if (isGeneralBinaryOp(op)
+        and foldConstants(&c,
+                          op,
+                          type,
+                          static_cast<Value*>(a),
+                          static_cast<Value*>(b),
+                          &folded)) {
+      return constant(folded, type);
+    }
+
     Value* result = value(&c, type);
 
     appendCombine(
@@ -2837,6 +3036,17 @@ class MyCompiler : public Compiler {
     assertT(&c,
             (isGeneralUnaryOp(op) and isGeneralValue(a))
             or (isFloatUnaryOp(op) and isFloatValue(a)));
+    unsigned size = a->type.size(c.targetInfo);
+    int64_t folded;
+    if (op == lir::Negate and a->type.flavor() == ir::Type::Integer
+        and (size == 4 or size == 8) and size <= c.targetInfo.pointerSize
+        and constantValue(&c, static_cast<Value*>(a), &folded)) {
+      uint64_t negated = 0 - static_cast<uint64_t>(folded);
+      return constant(size == 4 ? static_cast<int32_t>(negated)
+                                : static_cast<int64_t>(negated),
+                      a->type);
+    }
+
     Value* result = value(&c, a->type);
     appendTranslate(&c, op, static_cast<Value*>(a), result);
     return result;
@@ -362,11 +362,19 @@ class CallEvent : public Event {
             unsigned flags,
             TraceHandler* traceHandler,
             Value* resultValue,
-            util::Slice<ir::Value*> arguments)
+            util::Slice<ir::Value*> arguments,
+            lir::TernaryOperation guardOp,
+            Value* guardFirst,
+            Value* guardSecond,
+            Value* fallback)
       : Event(c),
         address(address),
         traceHandler(traceHandler),
         resultValue(resultValue),
+        guardOp(guardOp),
+        guardFirst(guardFirst),
+        guardSecond(guardSecond),
+        fallback(fallback),
         returnAddressSurrogate(0),
         framePointerSurrogate(0),
         popIndex(0),
@@ -432,6 +440,38 @@ class CallEvent : public Event {
       }
     }
 
+    if (guardSecond) {
+      assertT(c, callingConvention == ir::CallingConvention::Native);
+      assertT(c,
+              guardSecond->type.size(c->targetInfo)
+              <= c->targetInfo.pointerSize);
+
+      this->addRead(c,
+                    guardFirst,
+                    SiteMask(lir::Operand::RegisterPairMask
+                             | lir::Operand::ConstantMask,
+                             registerMask,
+                             AnyFrameIndex));
+
+      this->addRead(c,
+                    guardSecond,
+                    SiteMask(lir::Operand::RegisterPairMask,
+                             registerMask,
+                             AnyFrameIndex));
+
+      if (fallback) {
+        assertT(c,
+                resultValue->type.size(c->targetInfo)
+                <= c->targetInfo.pointerSize);
+
+        this->addRead(c,
+                      fallback,
+                      SiteMask(lir::Operand::RegisterPairMask,
+                               registerMask,
+                               AnyFrameIndex));
+      }
+    }
+
     if (DebugReads) {
       fprintf(stderr, "address read %p\n", address);
     }
@@ -627,6 +667,46 @@ class CallEvent : public Event {
       op = lir::Call;
     }
 
+    // the arguments, locals, and stack are in place by now, and the
+    // code which follows assumes the call clobbered every register, so
+    // skipping just the call instruction is safe:
+    CodePromise* skipPromise = 0;
+    if (guardSecond) {
+      unsigned size = guardSecond->type.size(c->targetInfo);
+      CodePromise* callPromise = codePromise(c, static_cast<Promise*>(0));
+      skipPromise = codePromise(c, static_cast<Promise*>(0));
+
+      ConstantSite call(callPromise);
+      apply(c,
+            guardOp,
+            size,
+            guardFirst->source,
+            guardFirst->source,
+            size,
+            guardSecond->source,
+            guardSecond->source,
+            c->targetInfo.pointerSize,
+            &call,
+            &call);
+
+      if (fallback) {
+        Site* result = registerSite(c, c->arch->returnLow());
+        apply(c,
+              lir::Move,
+              c->targetInfo.pointerSize,
+              fallback->source,
+              fallback->source,
+              c->targetInfo.pointerSize,
+              result,
+              result);
+      }
+
+      ConstantSite skip(skipPromise);
+      apply(c, lir::Jump, c->targetInfo.pointerSize, &skip, &skip);
+
+      callPromise->offset = c->assembler->offset();
+    }
+
     apply(c, op, c->targetInfo.pointerSize, address->source, address->source);
 
     if (traceHandler) {
@@ -634,6 +714,10 @@ class CallEvent : public Event {
                                 stackArgumentIndex);
     }
 
+    if (skipPromise) {
+      skipPromise->offset = c->assembler->offset();
+    }
+
     if (TailCalls) {
       if (flags & Compiler::TailJump) {
         if (returnAddressSurrogate) {
@@ -668,6 +752,10 @@ class CallEvent : public Event {
   Value* address;
   TraceHandler* traceHandler;
   Value* resultValue;
+  lir::TernaryOperation guardOp;
+  Value* guardFirst;
+  Value* guardSecond;
+  Value* fallback;
   Value* returnAddressSurrogate;
   Value* framePointerSurrogate;
   unsigned popIndex;
@@ -682,7 +770,11 @@ void appendCall(Context* c,
                 unsigned flags,
                 TraceHandler* traceHandler,
                 Value* result,
-                util::Slice<ir::Value*> arguments)
+                util::Slice<ir::Value*> arguments,
+                lir::TernaryOperation guardOp,
+                Value* guardFirst,
+                Value* guardSecond,
+                Value* fallback)
 {
   append(c,
          new (c->zone) CallEvent(c,
@@ -691,7 +783,11 @@ void appendCall(Context* c,
                                  flags,
                                  traceHandler,
                                  result,
-                                 arguments));
+                                 arguments,
+                                 guardOp,
+                                 guardFirst,
+                                 guardSecond,
+                                 fallback));
 }
 
 class ReturnEvent : public Event {
@@ -2097,6 +2193,287 @@ void appendBoundsCheck(Context* c,
          BoundsCheckEvent(c, object, lengthOffset, index, handler));
 }
 
+class CardMarkEvent : public Event {
+ public:
+  CardMarkEvent(Context* c, Value* index, Value* count, Value* cards)
+      : Event(c),
+        index(index),
+        count(count),
+        cards(cards),
+        dirty(value(c, ir::Type::i4(), constantSite(c, 1)))
+  {
+    bool thunk;
+    OperandMask dirtyMask;
+    c->arch->planSource(lir::Move, 1, dirtyMask, 1, &thunk);
+
+    assertT(c, not thunk);
+
+    this->addRead(c, index, generalRegisterMask(c));
+    this->addRead(c, count, generalRegisterMask(c));
+    this->addRead(c, cards, generalRegisterMask(c));
+    this->addRead(c,
+                  dirty,
+                  SiteMask(lir::Operand::RegisterPairMask,
+                           dirtyMask.lowRegisterMask,
+                           AnyFrameIndex));
+  }
+
+  virtual const char* name()
+  {
+    return "CardMarkEvent";
+  }
+
+  virtual void compile(Context* c)
+  {
+    Assembler* a = c->assembler;
+
+    CodePromise* nextPromise
+        = compiler::codePromise(c, static_cast<Promise*>(0));
+
+    ConstantSite next(nextPromise);
+    apply(c,
+          lir::JumpIfLessOrEqual,
+          c->targetInfo.pointerSize,
+          index->source,
+          index->source,
+          c->targetInfo.pointerSize,
+          count->source,
+          count->source,
+          c->targetInfo.pointerSize,
+          &next,
+          &next);
+
+    assertT(c, index->source->type(c) == lir::Operand::Type::RegisterPair);
+    assertT(c, cards->source->type(c) == lir::Operand::Type::RegisterPair);
+    MemorySite card(static_cast<RegisterSite*>(cards->source)->number,
+                    0,
+                    static_cast<RegisterSite*>(index->source)->number,
+                    1);
+    card.acquired = true;
+
+    apply(c, lir::Move, 1, dirty->source, dirty->source, 1, &card, &card);
+
+    nextPromise->offset = a->offset();
+
+    popRead(c, this, index);
+    popRead(c, this, count);
+    popRead(c, this, cards);
+    popRead(c, this, dirty);
+  }
+
+  Value* index;
+  Value* count;
+  Value* cards;
+  Value* dirty;
+};
+
+void appendCardMark(Context* c, Value* index, Value* count, Value* cards)
+{
+  append(c, new (c->zone) CardMarkEvent(c, index, count, cards));
+}
+
+class CompareAndSwapEvent : public Event {
+ public:
+  CompareAndSwapEvent(Context* c,
+                      Value* base,
+                      int displacement,
+                      Value* expected,
+                      Value* newValue,
+                      Value* result,
+                      const SiteMask& expectedMask,
+                      const SiteMask& newValueMask)
+      : Event(c),
+        base(base),
+        displacement(displacement),
+        expected(expected),
+        newValue(newValue),
+        result(result),
+        expectedMask(expectedMask)
+  {
+    this->addRead(
+        c,
+        base,
+        SiteMask(lir::Operand::RegisterPairMask,
+                 c->regFile->generalRegisters
+                 & RegisterMask(~static_cast<uint64_t>(
+                       expectedMask.registerMask)),
+                 AnyFrameIndex));
+    this->addRead(c, newValue, newValueMask);
+    this->addRead(c, expected, expectedMask, result);
+  }
+
+  virtual const char* name()
+  {
+    return "CompareAndSwapEvent";
+  }
+
+  virtual void compile(Context* c)
+  {
+    unsigned size = result->type.size(c->targetInfo);
+
+    freezeSource(c, c->targetInfo.pointerSize, base);
+    freezeSource(c, size, newValue);
+
+    Site* target = getTarget(c, expected, result, expectedMask);
+
+    assertT(c, base->source->type(c) == lir::Operand::Type::RegisterPair);
+    assertT(c, newValue->source->type(c) == lir::Operand::Type::RegisterPair);
+    assertT(c, target->type(c) == lir::Operand::Type::RegisterPair);
+
+    lir::Memory dst(static_cast<RegisterSite*>(base->source)->number,
+                    displacement);
+    lir::RegisterPair expectedRegister(
+        static_cast<RegisterSite*>(target)->number);
+    lir::RegisterPair newValueRegister(
+        static_cast<RegisterSite*>(newValue->source)->number);
+
+    c->assembler->compareAndSwap(
+        size, &dst, &expectedRegister, &newValueRegister);
+
+    thawSource(c, size, newValue);
+    thawSource(c, c->targetInfo.pointerSize, base);
+
+    for (Read* r = reads; r; r = r->eventNext) {
+      popRead(c, this, r->value);
+    }
+
+    target->thaw(c, expected);
+
+    if (live(c, result)) {
+      result->addSite(c, target);
+    }
+  }
+
+  Value* base;
+  int displacement;
+  Value* expected;
+  Value* newValue;
+  Value* result;
+  SiteMask expectedMask;
+};
+
+void appendCompareAndSwap(Context* c,
+                          Value* base,
+                          int displacement,
+                          Value* expected,
+                          Value* newValue,
+                          Value* result)
+{
+  bool thunk;
+  OperandMask expectedMask;
+  OperandMask newValueMask;
+  c->arch->planCompareAndSwap(result->type.size(c->targetInfo),
+                              expectedMask,
+                              newValueMask,
+                              &thunk);
+
+  assertT(c, not thunk);
+
+  append(c,
+         new (c->zone) CompareAndSwapEvent(c,
+                                           base,
+                                           displacement,
+                                           expected,
+                                           newValue,
+                                           result,
+                                           SiteMask::lowPart(expectedMask),
+                                           SiteMask::lowPart(newValueMask)));
+}
+
+class GuardedStoreEvent : public Event {
+ public:
+  GuardedStoreEvent(Context* c,
+                    lir::TernaryOperation op,
+                    Value* first,
+                    Value* second,
+                    Value* src,
+                    Value* base,
+                    int displacement)
+      : Event(c),
+        op(op),
+        first(first),
+        second(second),
+        src(src),
+        base(base),
+        displacement(displacement)
+  {
+    this->addRead(c, first, generalRegisterOrConstantMask(c));
+    this->addRead(c, second, generalRegisterMask(c));
+    this->addRead(c, src, generalRegisterMask(c));
+    this->addRead(c, base, generalRegisterMask(c));
+  }
+
+  virtual const char* name()
+  {
+    return "GuardedStoreEvent";
+  }
+
+  virtual void compile(Context* c)
+  {
+    Assembler* a = c->assembler;
+
+    unsigned size = src->type.size(c->targetInfo);
+
+    CodePromise* storePromise
+        = compiler::codePromise(c, static_cast<Promise*>(0));
+    CodePromise* nextPromise
+        = compiler::codePromise(c, static_cast<Promise*>(0));
+
+    ConstantSite store(storePromise);
+    apply(c,
+          op,
+          second->type.size(c->targetInfo),
+          first->source,
+          first->source,
+          second->type.size(c->targetInfo),
+          second->source,
+          second->source,
+          c->targetInfo.pointerSize,
+          &store,
+          &store);
+
+    ConstantSite next(nextPromise);
+    apply(c, lir::Jump, c->targetInfo.pointerSize, &next, &next);
+
+    storePromise->offset = a->offset();
+
+    assertT(c, base->source->type(c) == lir::Operand::Type::RegisterPair);
+    MemorySite dst(static_cast<RegisterSite*>(base->source)->number,
+                   displacement,
+                   NoRegister,
+                   1);
+    dst.acquired = true;
+
+    apply(c, lir::Move, size, src->source, src->source, size, &dst, &dst);
+
+    nextPromise->offset = a->offset();
+
+    for (Read* r = reads; r; r = r->eventNext) {
+      popRead(c, this, r->value);
+    }
+  }
+
+  lir::TernaryOperation op;
+  Value* first;
+  Value* second;
+  Value* src;
+  Value* base;
+  int displacement;
+};
+
+void appendGuardedStore(Context* c,
+                        lir::TernaryOperation op,
+                        Value* first,
+                        Value* second,
+                        Value* src,
+                        Value* base,
+                        int displacement)
+{
+  append(c,
+         new (c->zone) GuardedStoreEvent(
+             c, op, first, second, src, base, displacement));
+}
+
 class FrameSiteEvent : public Event {
  public:
   FrameSiteEvent(Context* c, Value* value, int index)
@@ -149,7 +149,11 @@ void appendCall(Context* c,
                 unsigned flags,
                 TraceHandler* traceHandler,
                 Value* result,
-                util::Slice<ir::Value*> arguments);
+                util::Slice<ir::Value*> arguments,
+                lir::TernaryOperation guardOp = lir::NoTernaryOperation,
+                Value* guardFirst = 0,
+                Value* guardSecond = 0,
+                Value* fallback = 0);
 
 void appendReturn(Context* c, Value* value);
 
@@ -199,6 +203,23 @@ void appendBoundsCheck(Context* c,
                        Value* index,
                        intptr_t handler);
 
+void appendCardMark(Context* c, Value* index, Value* count, Value* cards);
+
+void appendCompareAndSwap(Context* c,
+                          Value* base,
+                          int displacement,
+                          Value* expected,
+                          Value* newValue,
+                          Value* result);
+
+void appendGuardedStore(Context* c,
+                        lir::TernaryOperation op,
+                        Value* first,
+                        Value* second,
+                        Value* src,
+                        Value* base,
+                        int displacement);
+
 void appendFrameSite(Context* c, Value* value, int index);
 
 void appendSaveLocals(Context* c);
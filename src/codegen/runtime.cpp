@@ -144,6 +144,36 @@ uint64_t squareRootDouble(uint64_t a)
   return vm::doubleToBits(sqrt(vm::bitsToDouble(a)));
 }
 
+uint64_t sineDouble(uint64_t a)
+{
+  return vm::doubleToBits(sin(vm::bitsToDouble(a)));
+}
+
+uint64_t cosineDouble(uint64_t a)
+{
+  return vm::doubleToBits(cos(vm::bitsToDouble(a)));
+}
+
+uint64_t tangentDouble(uint64_t a)
+{
+  return vm::doubleToBits(tan(vm::bitsToDouble(a)));
+}
+
+uint64_t exponentDouble(uint64_t a)
+{
+  return vm::doubleToBits(exp(vm::bitsToDouble(a)));
+}
+
+uint64_t logarithmDouble(uint64_t a)
+{
+  return vm::doubleToBits(log(vm::bitsToDouble(a)));
+}
+
+uint64_t powerDouble(uint64_t b, uint64_t a)
+{
+  return vm::doubleToBits(pow(vm::bitsToDouble(a), vm::bitsToDouble(b)));
+}
+
 uint64_t doubleToFloat(int64_t a)
 {
   return vm::floatToBits(static_cast<float>(vm::bitsToDouble(a)));
@@ -441,6 +441,9 @@ class MyArchitecture : public Architecture {
       break;
 
     case lir::Absolute:
+    case lir::PopCount:
+    case lir::LeadingZeros:
+    case lir::ByteSwap:
       *thunk = true;
       break;
 
@@ -645,6 +648,14 @@ class MyArchitecture : public Architecture {
     }
   }
 
+  virtual void planCompareAndSwap(unsigned,
+                                  OperandMask&,
+                                  OperandMask&,
+                                  bool* thunk)
+  {
+    *thunk = true;
+  }
+
   virtual Assembler* makeAssembler(Alloc* allocator, Zone* zone);
 
   virtual void acquire()
@@ -979,6 +990,14 @@ class MyAssembler : public Assembler {
     }
   }
 
+  virtual void compareAndSwap(unsigned,
+                              lir::Memory*,
+                              lir::RegisterPair*,
+                              lir::RegisterPair*)
+  {
+    abort(&con);
+  }
+
   virtual void setDestination(uint8_t* dst)
   {
     con.result = dst;
@@ -470,10 +470,13 @@ class MyArchitecture : public Architecture {
     case lir::FloatAbsolute:
     case lir::FloatNegate:
     case lir::FloatSquareRoot:
+    case lir::PopCount:
+    case lir::LeadingZeros:
       return false;
 
     case lir::Negate:
     case lir::Absolute:
+    case lir::ByteSwap:
       return true;
 
     default:
@@ -531,6 +534,30 @@ class MyArchitecture : public Architecture {
       }
       break;
 
+    case lir::PopCount:
+      if (usePopCount(&c) and aSize <= TargetBytesPerWord) {
+        aMask.typeMask = lir::Operand::RegisterPairMask;
+      } else {
+        *thunk = true;
+      }
+      break;
+
+    case lir::LeadingZeros:
+      if (useLeadingZeroCount(&c) and aSize <= TargetBytesPerWord) {
+        aMask.typeMask = lir::Operand::RegisterPairMask;
+      } else {
+        *thunk = true;
+      }
+      break;
+
+    case lir::ByteSwap:
+      if (aSize == 4 or aSize == TargetBytesPerWord) {
+        aMask.typeMask = lir::Operand::RegisterPairMask;
+      } else {
+        *thunk = true;
+      }
+      break;
+
     case lir::FloatAbsolute:
       if (useSSE(&c)) {
         aMask.typeMask = lir::Operand::RegisterPairMask;
@@ -641,11 +668,17 @@ class MyArchitecture : public Architecture {
       break;
 
     case lir::Negate:
+    case lir::ByteSwap:
       bMask.typeMask = lir::Operand::RegisterPairMask;
       bMask.lowRegisterMask = aMask.lowRegisterMask;
       bMask.highRegisterMask = aMask.highRegisterMask;
       break;
 
+    case lir::PopCount:
+    case lir::LeadingZeros:
+      bMask.typeMask = lir::Operand::RegisterPairMask;
+      break;
+
     case lir::FloatNegate:
     case lir::FloatSquareRoot:
     case lir::Float2Float:
@@ -860,6 +893,22 @@ class MyArchitecture : public Architecture {
     }
   }
 
+  virtual void planCompareAndSwap(unsigned size,
+                                  OperandMask& expectedMask,
+                                  OperandMask& newValueMask,
+                                  bool* thunk)
+  {
+    // cmpxchg compares against and loads into rax implicitly:
+    expectedMask.typeMask = lir::Operand::RegisterPairMask;
+    expectedMask.setLowHighRegisterMasks(rax, 0);
+
+    newValueMask.typeMask = lir::Operand::RegisterPairMask;
+    newValueMask.setLowHighRegisterMasks(
+        GeneralRegisterMask.excluding(rax), 0);
+
+    *thunk = size > TargetBytesPerWord;
+  }
+
   virtual Assembler* makeAssembler(util::Alloc* allocator, Zone* zone);
 
   virtual void acquire()
@@ -1168,6 +1217,14 @@ class MyAssembler : public Assembler {
     }
   }
 
+  virtual void compareAndSwap(unsigned size,
+                              lir::Memory* dst,
+                              lir::RegisterPair* expected,
+                              lir::RegisterPair* newValue)
+  {
+    compareAndSwapRM(&c, size, expected, newValue, dst);
+  }
+
   virtual void setDestination(uint8_t* dst)
   {
     c.result = dst;
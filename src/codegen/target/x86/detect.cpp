@@ -40,6 +40,8 @@ static int __get_cpuid(unsigned int __level,
 }
 #define bit_SSE (1 << 25)
 #define bit_SSE2 (1 << 26)
+#define bit_POPCNT (1 << 23)
+#define bit_LZCNT (1 << 5)
 
 #endif  // ndef _MSC_VER
 
@@ -78,6 +80,49 @@ bool useSSE(ArchitectureContext* c)
 #endif
 }
 
+bool usePopCount(ArchitectureContext* c)
+{
+#ifdef __arm__
+  return false;
+#else
+  if (c->useNativeFeatures) {
+    static int supported = -1;
+    if (supported == -1) {
+      unsigned eax;
+      unsigned ebx;
+      unsigned ecx;
+      unsigned edx;
+      supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_POPCNT);
+    }
+    return supported;
+  } else {
+    return false;
+  }
+#endif
+}
+
+bool useLeadingZeroCount(ArchitectureContext* c)
+{
+#ifdef __arm__
+  return false;
+#else
+  if (c->useNativeFeatures) {
+    static int supported = -1;
+    if (supported == -1) {
+      unsigned eax;
+      unsigned ebx;
+      unsigned ecx;
+      unsigned edx;
+      supported = __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx)
+                  && (ecx & bit_LZCNT);
+    }
+    return supported;
+  } else {
+    return false;
+  }
+#endif
+}
+
 }  // namespace x86
 }  // namespace codegen
 }  // namespace avian
@@ -21,6 +21,10 @@ class ArchitectureContext;
 
 bool useSSE(ArchitectureContext* c);
 
+bool usePopCount(ArchitectureContext* c);
+
+bool useLeadingZeroCount(ArchitectureContext* c);
+
 }  // namespace x86
 }  // namespace codegen
 }  // namespace avian
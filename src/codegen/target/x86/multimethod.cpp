@@ -169,6 +169,10 @@ void populateTables(ArchitectureContext* c)
   bo[index(c, lir::Absolute, R, R)] = CAST2(absoluteRR);
   bo[index(c, lir::FloatAbsolute, R, R)] = CAST2(floatAbsoluteRR);
 
+  bo[index(c, lir::PopCount, R, R)] = CAST2(popCountRR);
+  bo[index(c, lir::LeadingZeros, R, R)] = CAST2(leadingZerosRR);
+  bo[index(c, lir::ByteSwap, R, R)] = CAST2(byteSwapRR);
+
   bro[branchIndex(c, R, R)] = CAST_BRANCH(branchRR);
   bro[branchIndex(c, C, R)] = CAST_BRANCH(branchCR);
   bro[branchIndex(c, C, M)] = CAST_BRANCH(branchCM);
@@ -1754,6 +1754,64 @@ void absoluteRR(Context* c,
   c->client->releaseTemporary(rdx);
 }
 
+void popCountRR(Context* c,
+                unsigned aSize,
+                lir::RegisterPair* a,
+                unsigned bSize UNUSED,
+                lir::RegisterPair* b)
+{
+  assertT(c, aSize == bSize and aSize <= vm::TargetBytesPerWord);
+
+  opcode(c, 0xf3);
+  maybeRex(c, aSize, b, a);
+  opcode(c, 0x0f, 0xb8);
+  modrm(c, 0xc0, a, b);
+}
+
+void leadingZerosRR(Context* c,
+                    unsigned aSize,
+                    lir::RegisterPair* a,
+                    unsigned bSize UNUSED,
+                    lir::RegisterPair* b)
+{
+  assertT(c, aSize == bSize and aSize <= vm::TargetBytesPerWord);
+
+  // lzcnt, which processors lacking it decode as bsr:
+  opcode(c, 0xf3);
+  maybeRex(c, aSize, b, a);
+  opcode(c, 0x0f, 0xbd);
+  modrm(c, 0xc0, a, b);
+}
+
+void byteSwapRR(Context* c,
+                unsigned aSize,
+                lir::RegisterPair* a,
+                unsigned bSize UNUSED,
+                lir::RegisterPair* b UNUSED)
+{
+  assertT(c, aSize == bSize and a->low == b->low);
+  assertT(c, aSize == 4 or aSize == vm::TargetBytesPerWord);
+
+  maybeRex(c, aSize, a);
+  opcode(c, 0x0f, 0xc8 + regCode(a));
+}
+
+void compareAndSwapRM(Context* c,
+                      unsigned size,
+                      lir::RegisterPair* expected UNUSED,
+                      lir::RegisterPair* newValue,
+                      lir::Memory* dst)
+{
+  assertT(c, size == 4 or size == vm::TargetBytesPerWord);
+  assertT(c, expected->low == rax);
+
+  // lock cmpxchg:
+  opcode(c, 0xf0);
+  maybeRex(c, size, newValue, dst);
+  opcode(c, 0x0f, 0xb1);
+  modrmSibImm(c, newValue, dst);
+}
+
 }  // namespace x86
 }  // namespace codegen
 }  // namespace avian
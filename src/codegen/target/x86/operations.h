@@ -452,6 +452,30 @@ void absoluteRR(Context* c,
                 unsigned bSize UNUSED,
                 lir::RegisterPair* b UNUSED);
 
+void popCountRR(Context* c,
+                unsigned aSize,
+                lir::RegisterPair* a,
+                unsigned bSize UNUSED,
+                lir::RegisterPair* b);
+
+void leadingZerosRR(Context* c,
+                    unsigned aSize,
+                    lir::RegisterPair* a,
+                    unsigned bSize UNUSED,
+                    lir::RegisterPair* b);
+
+void byteSwapRR(Context* c,
+                unsigned aSize,
+                lir::RegisterPair* a,
+                unsigned bSize UNUSED,
+                lir::RegisterPair* b UNUSED);
+
+void compareAndSwapRM(Context* c,
+                      unsigned size,
+                      lir::RegisterPair* expected UNUSED,
+                      lir::RegisterPair* newValue,
+                      lir::Memory* dst);
+
 }  // namespace x86
 }  // namespace codegen
 }  // namespace avian
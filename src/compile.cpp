@@ -80,6 +80,10 @@ const unsigned MaxNativeCallFootprint = TargetBytesPerWord == 8 ? 4 : 5;
 
 const unsigned InitialZoneCapacityInBytes = 64 * 1024;
 
+// lookupswitch instructions with at most this many cases are compiled
+// as a sequence of comparisons rather than a search:
+const unsigned LookupSwitchChainLimit = 8;
+
 enum ThunkIndex {
   compileMethodIndex,
   compileVirtualMethodIndex,
@@ -277,6 +281,8 @@ class MyThread : public Thread {
         transition(0),
         traceContext(0),
         stackLimit(0),
+        cardTable(m->cardTable),
+        thinLockTable(&(m->thinLocks)),
         referenceFrame(0),
         methodLockIsClean(true)
   {
@@ -304,6 +310,8 @@ class MyThread : public Thread {
   Context* transition;
   TraceContext* traceContext;
   uintptr_t stackLimit;
+  Heap::CardTable* cardTable;
+  ThinLockTable* thinLockTable;
   List<Reference*>* referenceFrame;
   bool methodLockIsClean;
 };
@@ -796,6 +804,9 @@ class TraceElement : public avian::codegen::TraceHandler {
   static const unsigned VirtualCall = 1 << 0;
   static const unsigned TailCall = 1 << 1;
   static const unsigned LongCall = 1 << 2;
+  // never set for boot image code, whose call table only has room
+  // for the flags above:
+  static const unsigned Devirtualized = 1 << 3;
 
   TraceElement(Context* context,
                unsigned ip,
@@ -835,6 +846,23 @@ class TraceElement : public avian::codegen::TraceHandler {
   uintptr_t map[0];
 };
 
+// returns the operation with which to patch an aligned call site
+// having the specified trace flags:
+avian::codegen::lir::UnaryOperation alignedCallOperation(unsigned traceFlags)
+{
+  if (traceFlags & TraceElement::LongCall) {
+    if (traceFlags & TraceElement::TailCall) {
+      return avian::codegen::lir::AlignedLongJump;
+    } else {
+      return avian::codegen::lir::AlignedLongCall;
+    }
+  } else if (traceFlags & TraceElement::TailCall) {
+    return avian::codegen::lir::AlignedJump;
+  } else {
+    return avian::codegen::lir::AlignedCall;
+  }
+}
+
 class TraceElementPromise : public avian::codegen::Promise {
  public:
   TraceElementPromise(System* s, TraceElement* trace) : s(s), trace(trace)
@@ -1180,6 +1208,8 @@ class Context {
             &zone,
             method->code()->length() * frameMapSizeInWords(t, method),
             ~(uintptr_t)0)),
+        uncheckedArrayAccesses(0, 0),
+        selfCalls(0, 0),
         executableAllocator(0),
         executableStart(0),
         executableSize(0),
@@ -1209,6 +1239,8 @@ class Context {
         traceLog(0),
         visitTable(0, 0),
         rootTable(0, 0),
+        uncheckedArrayAccesses(0, 0),
+        selfCalls(0, 0),
         executableAllocator(0),
         executableStart(0),
         executableSize(0),
@@ -1249,6 +1281,16 @@ class Context {
     }
   }
 
+  bool uncheckedArrayAccess(unsigned ip)
+  {
+    return ip < uncheckedArrayAccesses.count and uncheckedArrayAccesses[ip];
+  }
+
+  bool selfCall(unsigned ip)
+  {
+    return ip < selfCalls.count and selfCalls[ip];
+  }
+
   void extendLogicalCode(unsigned more)
   {
     compiler->extendLogicalCode(more);
@@ -1271,6 +1313,8 @@ class Context {
   TraceElement* traceLog;
   Slice<uint16_t> visitTable;
   Slice<uintptr_t> rootTable;
+  Slice<bool> uncheckedArrayAccesses;
+  Slice<bool> selfCalls;
   Alloc* executableAllocator;
   void* executableStart;
   unsigned executableSize;
@@ -1416,6 +1460,12 @@ void storeLocal(Context* context,
 
 avian::util::FixedAllocator* codeAllocator(MyThread* t);
 
+void codeAreaBounds(MyThread* t, uintptr_t* start, uintptr_t* end);
+
+#ifndef AVIAN_AOT_ONLY
+void ensureCodeCapacity(MyThread* t, size_t size);
+#endif
+
 ir::Type operandTypeForFieldCode(Thread* t, unsigned code)
 {
   switch (code) {
@@ -2392,6 +2442,15 @@ uintptr_t bootNativeThunk(MyThread* t);
 
 uintptr_t virtualThunk(MyThread* t, unsigned index);
 
+uintptr_t dispatchStub(MyThread* t, unsigned index);
+
+void invalidateDevirtualizedCalls(MyThread* t, GcMethod* method);
+
+void updateCall(MyThread* t,
+                avian::codegen::lir::UnaryOperation op,
+                void* returnAddress,
+                void* target);
+
 bool unresolved(MyThread* t, uintptr_t methodAddress);
 
 uintptr_t methodAddress(Thread* t, GcMethod* method)
@@ -2485,6 +2544,63 @@ int64_t findInterfaceMethodFromInstanceAndReference(MyThread* t,
   return findInterfaceMethodFromInstance(t, method, instance);
 }
 
+// Records in the specified call cache that instances of class_ should
+// dispatch to the vtable entry at the specified offset.  Each entry
+// is claimed by setting its offset before its class is published,
+// and is never changed thereafter, so compiled code reading the cache
+// concurrently can never pair one class with another's offset.  Once
+// both entries are claimed the site is megamorphic and simply
+// continues to call findInterfaceMethodFromInstanceAndCache.
+void updateCallCache(MyThread* t,
+                     GcCallCache* cache,
+                     GcClass* class_,
+                     uintptr_t offset)
+{
+  if (cache->first() == class_ or cache->second() == class_) {
+    return;
+  }
+
+  if (atomicCompareAndSwap(&(cache->firstOffset()), 0, offset)) {
+    storeStoreMemoryBarrier();
+    cache->setFirst(t, class_);
+  } else if (atomicCompareAndSwap(&(cache->secondOffset()), 0, offset)) {
+    storeStoreMemoryBarrier();
+    cache->setSecond(t, class_);
+  }
+}
+
+int64_t findInterfaceMethodFromInstanceAndCache(MyThread* t,
+                                                GcMethod* method,
+                                                object instance,
+                                                GcCallCache* cache)
+{
+  if (instance == 0) {
+    throwNew(t, GcNullPointerException::Type);
+  }
+
+  GcClass* class_ = objectClass(t, instance);
+  PROTECT(t, class_);
+  PROTECT(t, cache);
+
+  GcMethod* target = findInterfaceMethod(t, method, class_);
+
+  // only methods reachable through the receiver's vtable may be
+  // cached, since compiled code will load the address from there:
+  if (methodVirtual(t, target) and (target->flags() & ACC_ABSTRACT) == 0
+      and (target->class_()->flags() & ACC_INTERFACE) == 0) {
+    GcArray* vtable = cast<GcArray>(t, class_->virtualTable());
+    if (vtable and target->offset() < vtable->length()
+        and vtable->body()[target->offset()] == target) {
+      updateCallCache(t,
+                      cache,
+                      class_,
+                      ClassVtable + (target->offset() * BytesPerWord));
+    }
+  }
+
+  return prepareMethodForCall(t, target);
+}
+
 void checkMethod(Thread* t, GcMethod* method, bool shouldBeStatic)
 {
   if (((method->flags() & ACC_STATIC) == 0) == shouldBeStatic) {
@@ -2699,13 +2815,9 @@ uint64_t lookUpAddress(int32_t key,
   return default_;
 }
 
-void setMaybeNull(MyThread* t, object o, unsigned offset, object value)
+void markFixed(MyThread* t, object o, unsigned offset)
 {
-  if (LIKELY(o)) {
-    setField(t, o, offset, value);
-  } else {
-    throwNew(t, GcNullPointerException::Type);
-  }
+  t->m->heap->mark(o, offset / BytesPerWord, 1);
 }
 
 void acquireMonitorForObject(MyThread* t, object o)
@@ -2808,6 +2920,19 @@ uint64_t makeMultidimensionalArrayFromReference(MyThread* t,
       offset);
 }
 
+void copyArray(MyThread* t, int32_t offset)
+{
+  // the arguments to System.arraycopy, with the last one on top:
+  uintptr_t* arguments = static_cast<uintptr_t*>(t->stack) + offset;
+
+  arrayCopy(t,
+            reinterpret_cast<object>(arguments[4]),
+            arguments[3],
+            reinterpret_cast<object>(arguments[2]),
+            arguments[1],
+            arguments[0]);
+}
+
 void NO_RETURN throwArrayIndexOutOfBounds(MyThread* t)
 {
   if (ensure(t, GcArrayIndexOutOfBoundsException::FixedSize + traceSize(t))) {
@@ -2859,6 +2984,24 @@ void checkCast(MyThread* t, GcClass* class_, object o)
   }
 }
 
+// like checkCast, but also records the class of o in the specified
+// cache if the cast succeeds, so that compiled code can accept that
+// class next time without calling us (see compileTypeCheck)
+void checkCastAndCache(MyThread* t,
+                       GcClass* class_,
+                       object o,
+                       GcTypeCheckCache* cache)
+{
+  PROTECT(t, o);
+  PROTECT(t, cache);
+
+  checkCast(t, class_, o);
+
+  if (o) {
+    cache->setHit(t, objectClass(t, o));
+  }
+}
+
 void checkCastFromReference(MyThread* t, GcPair* pair, object o)
 {
   PROTECT(t, o);
@@ -3070,6 +3213,24 @@ uint64_t instanceOfFromReference(Thread* t, GcPair* pair, object o)
   return instanceOf64(t, c, o);
 }
 
+// like instanceOf64, but also records the class of o in the
+// specified cache if the result is true (see compileTypeCheck)
+uint64_t instanceOfAndCache(Thread* t,
+                            GcClass* class_,
+                            object o,
+                            GcTypeCheckCache* cache)
+{
+  PROTECT(t, o);
+  PROTECT(t, cache);
+
+  if (instanceOf(t, class_, o)) {
+    cache->setHit(t, objectClass(t, o));
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
 uint64_t makeNewGeneral64(Thread* t, GcClass* class_)
 {
   PROTECT(t, class_);
@@ -3118,6 +3279,10 @@ void gcIfNecessary(MyThread* t)
 
 void idleIfNecessary(MyThread* t)
 {
+  // clear the flag before checking, so a request made after the check
+  // is seen at the next safe point:
+  t->clearFlag(Thread::SafePointFlag);
+
   if (UNLIKELY(t->m->exclusive)) {
     ENTER(t, Thread::IdleState);
   }
@@ -3126,10 +3291,9 @@ void idleIfNecessary(MyThread* t)
 bool useLongJump(MyThread* t, uintptr_t target)
 {
   uintptr_t reach = t->arch->maximumImmediateJump();
-  FixedAllocator* a = codeAllocator(t);
-  uintptr_t start = reinterpret_cast<uintptr_t>(a->memory.begin());
-  uintptr_t end = reinterpret_cast<uintptr_t>(a->memory.begin())
-                  + a->memory.count;
+  uintptr_t start;
+  uintptr_t end;
+  codeAreaBounds(t, &start, &end);
   assertT(t, end - start < reach);
 
   return (target > end && (target - start) > reach)
@@ -3203,9 +3367,22 @@ ir::Value* popField(MyThread* t, Frame* frame, int code)
   }
 }
 
+// polls for a pending request for exclusive access, calling
+// idleIfNecessary only if Thread::SafePointFlag has been set
 void compileSafePoint(MyThread* t, Compiler* c, Frame* frame)
 {
-  c->nativeCall(
+  c->guardedNativeCall(
+      lir::JumpIfNotEqual,
+      c->constant(0, ir::Type::i4()),
+      c->binaryOp(
+          lir::And,
+          ir::Type::i4(),
+          c->constant(Thread::SafePointFlag, ir::Type::i4()),
+          c->load(ir::ExtendMode::Signed,
+                  c->memory(
+                      c->threadRegister(), ir::Type::i4(), TARGET_THREAD_FLAGS),
+                  ir::Type::i4())),
+      0,
       c->constant(getThunk(t, idleIfNecessaryThunk), ir::Type::iptr()),
       0,
       frame->trace(0, 0),
@@ -3322,6 +3499,58 @@ bool compileDirectInvoke(MyThread* t,
   return tailCall;
 }
 
+// Returns true if a virtual call to target may be compiled as a
+// direct call, which is the case if no class loaded so far overrides
+// it.  If such a class is loaded later, methodOverridden will patch
+// the call to dispatch through the vtable instead.
+bool isDevirtualizable(Frame* frame, GcMethod* target, bool tailCall)
+{
+  return frame->context->bootContext == 0
+         and (not(avian::codegen::TailCalls and tailCall))
+         and (target->flags() & (ACC_ABSTRACT | ACC_NATIVE)) == 0
+         and (target->class_()->flags() & ACC_INTERFACE) == 0
+         and (target->vmFlags() & OverriddenFlag) == 0;
+}
+
+void compileDevirtualizedInvoke(MyThread* t,
+                                Frame* frame,
+                                GcMethod* target,
+                                bool checkNull)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  // a vtable lookup would fault on a null receiver, but a direct call
+  // won't, so we must check explicitly unless the receiver is "this":
+  if (checkNull) {
+    c->guardedNativeCall(
+        lir::JumpIfEqual,
+        c->constant(0, ir::Type::object()),
+        c->peek(1, target->parameterFootprint() - 1),
+        0,
+        c->constant(getThunk(t, throw_Thunk), ir::Type::iptr()),
+        0,
+        frame->trace(0, 0),
+        ir::Type::void_(),
+        args(c->threadRegister(), c->constant(0, ir::Type::object())));
+  }
+
+  // the call is always aligned so it may be safely patched while
+  // other threads are running:
+  uintptr_t address = methodAddress(t, target);
+  unsigned flags = Compiler::Aligned;
+  unsigned traceFlags = TraceElement::Devirtualized;
+
+  if (useLongJump(t, address)) {
+    flags |= Compiler::LongJumpOrCall;
+    traceFlags |= TraceElement::LongCall;
+  }
+
+  frame->stackCall(c->constant(address, ir::Type::iptr()),
+                   target,
+                   flags,
+                   frame->trace(target, traceFlags));
+}
+
 void compileReferenceInvoke(Frame* frame,
                             ir::Value* method,
                             GcReference* reference,
@@ -3388,27 +3617,475 @@ void compileDirectAbstractInvoke(MyThread* t,
       tailCall);
 }
 
-void handleMonitorEvent(MyThread* t, Frame* frame, intptr_t function)
+// returns one if value (an iptr) is non-zero and zero otherwise
+ir::Value* nonZero(avian::codegen::Compiler* c, ir::Value* value)
+{
+  return c->binaryOp(
+      lir::UnsignedShiftRight,
+      ir::Type::iptr(),
+      c->constant((TargetBytesPerWord * 8) - 1, ir::Type::i4()),
+      c->binaryOp(lir::Or,
+                  ir::Type::iptr(),
+                  c->unaryOp(lir::Negate, value),
+                  value));
+}
+
+// Emits a bimorphic inline cache for an invokeinterface call site
+// with a resolved target, returning the address to call.  If the
+// receiver's class matches either entry in the site's call cache, the
+// address is loaded directly from the receiver's vtable; otherwise we
+// call findInterfaceMethodFromInstanceAndCache, which may fill an
+// empty entry (see updateCallCache).  The class and offset loads
+// are branch-free so the only conditional is the guarded call.
+ir::Value* compileCachedInterfaceLookup(MyThread* t,
+                                        Frame* frame,
+                                        GcMethod* target,
+                                        ir::Value* instance)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  PROTECT(t, target);
+
+  GcCallCache* cache = makeCallCache(t, 0, 0, 0, 0);
+
+  ir::Value* cell = frame->append(cache);
+
+  ir::Value* class_ = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      c->constant(TargetPointerMask, ir::Type::iptr()),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(instance, ir::Type::iptr()),
+              ir::Type::iptr()));
+
+  // one if the receiver's class is not the first entry's:
+  ir::Value* notFirst = nonZero(
+      c,
+      c->binaryOp(lir::Xor,
+                  ir::Type::iptr(),
+                  class_,
+                  c->load(ir::ExtendMode::Signed,
+                          c->memory(cell, ir::Type::iptr(), CallCacheFirst),
+                          ir::Type::iptr())));
+
+  ir::Value* miss = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      notFirst,
+      nonZero(c,
+              c->binaryOp(
+                  lir::Xor,
+                  ir::Type::iptr(),
+                  class_,
+                  c->load(ir::ExtendMode::Signed,
+                          c->memory(cell, ir::Type::iptr(), CallCacheSecond),
+                          ir::Type::iptr()))));
+
+  // an entry's offset is stored before its class, so it must be
+  // loaded after:
+  c->nullaryOp(lir::LoadBarrier);
+
+  ir::Value* firstOffset
+      = c->load(ir::ExtendMode::Signed,
+                c->memory(cell, ir::Type::iptr(), CallCacheFirstOffset),
+                ir::Type::iptr());
+
+  // select the second entry's offset if the first entry missed, and
+  // zero (i.e. the class header, which is harmless to load) if both
+  // did:
+  ir::Value* offset = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      c->binaryOp(lir::Subtract,
+                  ir::Type::iptr(),
+                  c->constant(1, ir::Type::iptr()),
+                  miss),
+      c->binaryOp(
+          lir::Xor,
+          ir::Type::iptr(),
+          firstOffset,
+          c->binaryOp(
+              lir::And,
+              ir::Type::iptr(),
+              c->unaryOp(lir::Negate, notFirst),
+              c->binaryOp(
+                  lir::Xor,
+                  ir::Type::iptr(),
+                  firstOffset,
+                  c->load(ir::ExtendMode::Signed,
+                          c->memory(
+                              cell, ir::Type::iptr(), CallCacheSecondOffset),
+                          ir::Type::iptr())))));
+
+  return c->guardedNativeCall(
+      lir::JumpIfNotEqual,
+      c->constant(0, ir::Type::iptr()),
+      miss,
+      c->load(ir::ExtendMode::Signed,
+              c->memory(c->binaryOp(lir::Add, ir::Type::iptr(), offset, class_),
+                        ir::Type::iptr()),
+              ir::Type::iptr()),
+      c->constant(getThunk(t, findInterfaceMethodFromInstanceAndCacheThunk),
+                  ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      ir::Type::iptr(),
+      args(c->threadRegister(), frame->append(target), instance, cell));
+}
+
+// Emits an inline type check of instance against the resolved class
+// class_ for checkcast or instanceof, calling the specified thunk
+// (checkCastAndCache or instanceOfAndCache) only if instance is
+// neither null nor an instance of class_ itself or of the last class
+// the thunk accepted at this site.  If the thunk is not called, the
+// result is one for a non-null instance and zero otherwise.
+ir::Value* compileTypeCheck(MyThread* t,
+                            Frame* frame,
+                            GcClass* class_,
+                            ir::Value* instance,
+                            Thunk thunk,
+                            ir::Type resultType)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  PROTECT(t, class_);
+
+  GcTypeCheckCache* cache = makeTypeCheckCache(t, 0);
+
+  ir::Value* cell = frame->append(cache);
+
+  ir::Value* present = nonZero(c, instance);
+
+  // load the class from the cache itself rather than dereferencing a
+  // null instance; the result is ignored in that case anyway:
+  ir::Value* base = c->binaryOp(
+      lir::Xor,
+      ir::Type::iptr(),
+      instance,
+      c->binaryOp(lir::And,
+                  ir::Type::iptr(),
+                  c->binaryOp(lir::Subtract,
+                              ir::Type::iptr(),
+                              c->constant(1, ir::Type::iptr()),
+                              present),
+                  c->binaryOp(lir::Xor, ir::Type::iptr(), cell, instance)));
+
+  ir::Value* instanceClass = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      c->constant(TargetPointerMask, ir::Type::iptr()),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(base, ir::Type::iptr()),
+              ir::Type::iptr()));
+
+  ir::Value* miss = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      present,
+      c->binaryOp(
+          lir::And,
+          ir::Type::iptr(),
+          nonZero(c,
+                  c->binaryOp(lir::Xor,
+                              ir::Type::iptr(),
+                              instanceClass,
+                              frame->append(class_))),
+          nonZero(c,
+                  c->binaryOp(
+                      lir::Xor,
+                      ir::Type::iptr(),
+                      instanceClass,
+                      c->load(ir::ExtendMode::Signed,
+                              c->memory(
+                                  cell, ir::Type::iptr(), TypeCheckCacheHit),
+                              ir::Type::iptr())))));
+
+  return c->guardedNativeCall(
+      lir::JumpIfNotEqual,
+      c->constant(0, ir::Type::iptr()),
+      miss,
+      resultType == ir::Type::void_() ? 0 : present,
+      c->constant(getThunk(t, thunk), ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      resultType,
+      args(c->threadRegister(), frame->append(class_), instance, cell));
+}
+
+bool inlineCompareAndSwap(MyThread* t, unsigned size)
+{
+  OperandMask expectedMask;
+  OperandMask newValueMask;
+  bool thunk;
+  t->arch->planCompareAndSwap(size, expectedMask, newValueMask, &thunk);
+
+  return not thunk;
+}
+
+bool inlineMonitors(MyThread* t)
+{
+  return TargetBytesPerWord == BytesPerWord
+         and inlineCompareAndSwap(t, TargetBytesPerWord);
+}
+
+// returns the address of the first entry probed by findThinLock for
+// lock, which is the only one we look at inline
+ir::Value* thinLockEntry(avian::codegen::Compiler* c, ir::Value* lock)
+{
+  ir::Value* table = c->load(ir::ExtendMode::Signed,
+                             c->memory(c->threadRegister(),
+                                       ir::Type::iptr(),
+                                       TARGET_THREAD_THINLOCKTABLE),
+                             ir::Type::iptr());
+
+  ir::Value* index = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(table, ir::Type::iptr(), TargetBytesPerWord),
+              ir::Type::iptr()),
+      c->binaryOp(
+          lir::Multiply,
+          ir::Type::iptr(),
+          c->constant(0x9E3779B1, ir::Type::iptr()),
+          c->binaryOp(lir::UnsignedShiftRight,
+                      ir::Type::iptr(),
+                      c->constant(log(TargetBytesPerWord), ir::Type::i4()),
+                      lock)));
+
+  return c->binaryOp(
+      lir::Add,
+      ir::Type::iptr(),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(table, ir::Type::iptr(), 0),
+              ir::Type::iptr()),
+      c->binaryOp(lir::Multiply,
+                  ir::Type::iptr(),
+                  c->constant(sizeof(ThinLock), ir::Type::iptr()),
+                  index));
+}
+
+// acquires lock (see acquire in machine.h) inline if it already has a
+// thin lock entry which is either unlocked or held by this thread,
+// calling the specified thunk otherwise.  The thunk is also called,
+// and expected to throw, if lock is null.
+void compileMonitorAcquire(MyThread* t,
+                           Frame* frame,
+                           ir::Value* lock,
+                           Thunk thunk)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  if (not inlineMonitors(t)) {
+    c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                  0,
+                  frame->trace(0, 0),
+                  ir::Type::void_(),
+                  args(c->threadRegister(), lock));
+    return;
+  }
+
+  c->guardedNativeCall(lir::JumpIfEqual,
+                       c->constant(0, ir::Type::object()),
+                       lock,
+                       0,
+                       c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                       0,
+                       frame->trace(0, 0),
+                       ir::Type::void_(),
+                       args(c->threadRegister(), lock));
+
+  ir::Value* entry = thinLockEntry(c, lock);
+
+  ir::Value* miss = c->binaryOp(lir::Xor,
+                                ir::Type::iptr(),
+                                lock,
+                                c->load(ir::ExtendMode::Signed,
+                                        c->memory(entry, ir::Type::iptr(), 0),
+                                        ir::Type::iptr()));
+
+  // if the entry belongs to some other object, we expect an owner of
+  // two, which no thread or inflated monitor can match:
+  ir::Value* owner = c->compareAndSwap(
+      ir::Type::iptr(),
+      entry,
+      TargetBytesPerWord,
+      c->binaryOp(lir::ShiftLeft,
+                  ir::Type::iptr(),
+                  c->constant(1, ir::Type::i4()),
+                  nonZero(c, miss)),
+      c->threadRegister());
+
+  // zero if we already held the lock:
+  ir::Value* recursive = c->binaryOp(
+      lir::Or,
+      ir::Type::iptr(),
+      miss,
+      c->binaryOp(lir::Xor, ir::Type::iptr(), c->threadRegister(), owner));
+
+  c->guardedStore(
+      lir::JumpIfEqual,
+      c->constant(0, ir::Type::iptr()),
+      recursive,
+      c->binaryOp(lir::Add,
+                  ir::Type::iptr(),
+                  c->constant(1, ir::Type::iptr()),
+                  c->load(ir::ExtendMode::Signed,
+                          c->memory(entry,
+                                    ir::Type::iptr(),
+                                    TargetBytesPerWord * 2),
+                          ir::Type::iptr())),
+      entry,
+      TargetBytesPerWord * 2);
+
+  c->guardedNativeCall(
+      lir::JumpIfNotEqual,
+      c->constant(0, ir::Type::iptr()),
+      c->binaryOp(
+          lir::And,
+          ir::Type::iptr(),
+          nonZero(c, recursive),
+          nonZero(c, c->binaryOp(lir::Or, ir::Type::iptr(), miss, owner))),
+      0,
+      c->constant(getThunk(t, thunk), ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      ir::Type::void_(),
+      args(c->threadRegister(), lock));
+}
+
+// the counterpart of compileMonitorAcquire, releasing lock inline if
+// this thread holds it via a thin lock entry
+void compileMonitorRelease(MyThread* t,
+                           Frame* frame,
+                           ir::Value* lock,
+                           Thunk thunk)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  if (not inlineMonitors(t)) {
+    c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                  0,
+                  frame->trace(0, 0),
+                  ir::Type::void_(),
+                  args(c->threadRegister(), lock));
+    return;
+  }
+
+  c->guardedNativeCall(lir::JumpIfEqual,
+                       c->constant(0, ir::Type::object()),
+                       lock,
+                       0,
+                       c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                       0,
+                       frame->trace(0, 0),
+                       ir::Type::void_(),
+                       args(c->threadRegister(), lock));
+
+  ir::Value* entry = thinLockEntry(c, lock);
+
+  ir::Value* miss = c->binaryOp(lir::Xor,
+                                ir::Type::iptr(),
+                                lock,
+                                c->load(ir::ExtendMode::Signed,
+                                        c->memory(entry, ir::Type::iptr(), 0),
+                                        ir::Type::iptr()));
+
+  ir::Value* depth = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(entry, ir::Type::iptr(), TargetBytesPerWord * 2),
+      ir::Type::iptr());
+
+  // unlock only if the entry is ours and this is the outermost
+  // acquisition, as in compileMonitorAcquire:
+  ir::Value* owner = c->compareAndSwap(
+      ir::Type::iptr(),
+      entry,
+      TargetBytesPerWord,
+      c->binaryOp(
+          lir::Or,
+          ir::Type::iptr(),
+          c->threadRegister(),
+          c->binaryOp(
+              lir::ShiftLeft,
+              ir::Type::iptr(),
+              c->constant(1, ir::Type::i4()),
+              nonZero(c,
+                      c->binaryOp(lir::Or, ir::Type::iptr(), miss, depth)))),
+      c->constant(0, ir::Type::iptr()));
+
+  // zero if we hold the lock:
+  ir::Value* held = c->binaryOp(
+      lir::Or,
+      ir::Type::iptr(),
+      miss,
+      c->binaryOp(lir::Xor, ir::Type::iptr(), c->threadRegister(), owner));
+
+  // zero if we hold the lock recursively:
+  ir::Value* recursive = c->binaryOp(
+      lir::Or,
+      ir::Type::iptr(),
+      held,
+      c->binaryOp(lir::Xor,
+                  ir::Type::iptr(),
+                  c->constant(1, ir::Type::iptr()),
+                  nonZero(c, depth)));
+
+  c->guardedStore(lir::JumpIfEqual,
+                  c->constant(0, ir::Type::iptr()),
+                  recursive,
+                  c->binaryOp(lir::Subtract,
+                              ir::Type::iptr(),
+                              c->constant(1, ir::Type::iptr()),
+                              depth),
+                  entry,
+                  TargetBytesPerWord * 2);
+
+  c->guardedNativeCall(
+      lir::JumpIfNotEqual,
+      c->constant(0, ir::Type::iptr()),
+      c->binaryOp(
+          lir::And,
+          ir::Type::iptr(),
+          nonZero(c, recursive),
+          nonZero(c, c->binaryOp(lir::Or, ir::Type::iptr(), held, depth))),
+      0,
+      c->constant(getThunk(t, thunk), ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      ir::Type::void_(),
+      args(c->threadRegister(), lock));
+}
+
+void handleMonitorEvent(MyThread* t,
+                        Frame* frame,
+                        Thunk objectThunk,
+                        Thunk classThunk,
+                        bool acquire)
 {
   avian::codegen::Compiler* c = frame->c;
   GcMethod* method = frame->context->method;
 
   if (method->flags() & ACC_SYNCHRONIZED) {
-    ir::Value* lock;
     if (method->flags() & ACC_STATIC) {
       PROTECT(t, method);
 
-      lock = frame->append(method->class_());
+      c->nativeCall(c->constant(getThunk(t, classThunk), ir::Type::iptr()),
+                    0,
+                    frame->trace(0, 0),
+                    ir::Type::void_(),
+                    args(c->threadRegister(),
+                         frame->append(method->class_())));
     } else {
-      lock = loadLocal(
+      ir::Value* lock = loadLocal(
           frame->context, 1, ir::Type::object(), savedTargetIndex(t, method));
-    }
 
-    c->nativeCall(c->constant(function, ir::Type::iptr()),
-                  0,
-                  frame->trace(0, 0),
-                  ir::Type::void_(),
-                  args(c->threadRegister(), lock));
+      if (acquire) {
+        compileMonitorAcquire(t, frame, lock, objectThunk);
+      } else {
+        compileMonitorRelease(t, frame, lock, objectThunk);
+      }
+    }
   }
 }
 
@@ -3429,20 +4106,18 @@ void handleEntrance(MyThread* t, Frame* frame)
 
   handleMonitorEvent(t,
                      frame,
-                     getThunk(t,
-                              method->flags() & ACC_STATIC
-                                  ? acquireMonitorForClassOnEntranceThunk
-                                  : acquireMonitorForObjectOnEntranceThunk));
+                     acquireMonitorForObjectOnEntranceThunk,
+                     acquireMonitorForClassOnEntranceThunk,
+                     true);
 }
 
 void handleExit(MyThread* t, Frame* frame)
 {
   handleMonitorEvent(t,
                      frame,
-                     getThunk(t,
-                              frame->context->method->flags() & ACC_STATIC
-                                  ? releaseMonitorForClassThunk
-                                  : releaseMonitorForObjectThunk));
+                     releaseMonitorForObjectThunk,
+                     releaseMonitorForClassThunk,
+                     false);
 }
 
 bool inTryBlock(MyThread* t UNUSED, GcCode* code, unsigned ip)
@@ -3711,202 +4386,698 @@ ir::Value* popLongAddress(Frame* frame)
                               ir::Type::iptr());
 }
 
-bool intrinsic(MyThread* t UNUSED, Frame* frame, GcMethod* target)
-{
-#define MATCH(name, constant)         \
-  (name->length() == sizeof(constant) \
-   and ::strcmp(reinterpret_cast<char*>(name->body().begin()), constant) == 0)
+void storeReference(MyThread* t,
+                    Frame* frame,
+                    ir::Value* object,
+                    ir::Value* offset,
+                    ir::Value* dst,
+                    ir::Value* value);
 
-  GcByteArray* className = target->class_()->name();
-  if (UNLIKELY(MATCH(className, "java/lang/Math"))) {
-    avian::codegen::Compiler* c = frame->c;
-    if (MATCH(target->name(), "sqrt") and MATCH(target->spec(), "(D)D")) {
-      frame->pushLarge(
-          ir::Type::f8(),
-          c->unaryOp(lir::FloatSquareRoot, frame->popLarge(ir::Type::f8())));
-      return true;
-    } else if (MATCH(target->name(), "abs")) {
-      if (MATCH(target->spec(), "(I)I")) {
-        frame->push(ir::Type::i4(),
-                    c->unaryOp(lir::Absolute, frame->pop(ir::Type::i4())));
-        return true;
-      } else if (MATCH(target->spec(), "(J)J")) {
-        frame->pushLarge(
-            ir::Type::i8(),
-            c->unaryOp(lir::Absolute, frame->popLarge(ir::Type::i8())));
-        return true;
-      } else if (MATCH(target->spec(), "(F)F")) {
-        frame->push(ir::Type::f4(),
-                    c->unaryOp(lir::FloatAbsolute, frame->pop(ir::Type::f4())));
-        return true;
-      }
-    }
-  } else if (UNLIKELY(MATCH(className, "sun/misc/Unsafe"))) {
-    avian::codegen::Compiler* c = frame->c;
-    if (MATCH(target->name(), "getByte") and MATCH(target->spec(), "(J)B")) {
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      frame->push(ir::Type::i4(),
-                  c->load(ir::ExtendMode::Signed,
-                          c->memory(address, ir::Type::i1()),
-                          ir::Type::i4()));
-      return true;
-    } else if (MATCH(target->name(), "putByte")
-               and MATCH(target->spec(), "(JB)V")) {
-      ir::Value* value = frame->pop(ir::Type::i4());
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      c->store(value, c->memory(address, ir::Type::i1()));
-      return true;
-    } else if ((MATCH(target->name(), "getShort")
-                and MATCH(target->spec(), "(J)S"))
-               or (MATCH(target->name(), "getChar")
-                   and MATCH(target->spec(), "(J)C"))) {
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      frame->push(ir::Type::i4(),
-                  c->load(ir::ExtendMode::Signed,
-                          c->memory(address, ir::Type::i2()),
-                          ir::Type::i4()));
-      return true;
-    } else if ((MATCH(target->name(), "putShort")
-                and MATCH(target->spec(), "(JS)V"))
-               or (MATCH(target->name(), "putChar")
-                   and MATCH(target->spec(), "(JC)V"))) {
-      ir::Value* value = frame->pop(ir::Type::i4());
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      c->store(value, c->memory(address, ir::Type::i2()));
-      return true;
-    } else if ((MATCH(target->name(), "getInt")
-                and MATCH(target->spec(), "(J)I"))
-               or (MATCH(target->name(), "getFloat")
-                   and MATCH(target->spec(), "(J)F"))) {
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      ir::Type type = MATCH(target->name(), "getInt") ? ir::Type::i4()
-                                                      : ir::Type::f4();
-      frame->push(
-          type,
-          c->load(ir::ExtendMode::Signed, c->memory(address, type), type));
-      return true;
-    } else if ((MATCH(target->name(), "putInt")
-                and MATCH(target->spec(), "(JI)V"))
-               or (MATCH(target->name(), "putFloat")
-                   and MATCH(target->spec(), "(JF)V"))) {
-      ir::Type type = MATCH(target->name(), "putInt") ? ir::Type::i4()
-                                                      : ir::Type::f4();
-      ir::Value* value = frame->pop(type);
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      c->store(value, c->memory(address, type));
-      return true;
-    } else if ((MATCH(target->name(), "getLong")
-                and MATCH(target->spec(), "(J)J"))
-               or (MATCH(target->name(), "getDouble")
-                   and MATCH(target->spec(), "(J)D"))) {
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      ir::Type type = MATCH(target->name(), "getLong") ? ir::Type::i8()
-                                                       : ir::Type::f8();
-      frame->pushLarge(
-          type,
-          c->load(ir::ExtendMode::Signed, c->memory(address, type), type));
-      return true;
-    } else if ((MATCH(target->name(), "putLong")
-                and MATCH(target->spec(), "(JJ)V"))
-               or (MATCH(target->name(), "putDouble")
-                   and MATCH(target->spec(), "(JD)V"))) {
-      ir::Type type = MATCH(target->name(), "putLong") ? ir::Type::i8()
-                                                       : ir::Type::f8();
-      ir::Value* value = frame->popLarge(type);
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      c->store(value, c->memory(address, type));
-      return true;
-    } else if (MATCH(target->name(), "getAddress")
-               and MATCH(target->spec(), "(J)J")) {
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      frame->pushLarge(ir::Type::i8(),
-                       c->load(ir::ExtendMode::Signed,
-                               c->memory(address, ir::Type::iptr()),
-                               ir::Type::i8()));
-      return true;
-    } else if (MATCH(target->name(), "putAddress")
-               and MATCH(target->spec(), "(JJ)V")) {
-      ir::Value* value = frame->popLarge(ir::Type::i8());
-      ir::Value* address = popLongAddress(frame);
-      frame->pop(ir::Type::object());
-      c->store(value, c->memory(address, ir::Type::iptr()));
-      return true;
-    }
-  }
-  return false;
-}
+void markReference(MyThread* t,
+                   Frame* frame,
+                   ir::Value* object,
+                   ir::Value* offset);
 
-unsigned targetFieldOffset(Context* context, GcField* field)
+// pops the object and long offset which sun.misc.Unsafe uses to
+// address a field or array element, returning the offset as a word
+// and the address itself
+ir::Value* popUnsafeAddress(Frame* frame,
+                            ir::Value** object,
+                            ir::Value** offset)
 {
-  if (context->bootContext) {
-    return context->bootContext->resolver->fieldOffset(context->thread, field);
-  } else {
-    return field->offset();
-  }
+  *offset = popLongAddress(frame);
+  *object = frame->pop(ir::Type::object());
+  return frame->c->binaryOp(lir::Add, ir::Type::iptr(), *offset, *object);
 }
 
-class Stack {
- public:
-  class MyResource : public Thread::AutoResource {
-   public:
-    MyResource(Stack* s) : AutoResource(s->thread), s(s)
-    {
-    }
+// atomically replaces the value at address with newValue if it equals
+// expected, returning one as an int if it did so and zero otherwise
+ir::Value* compileCompareAndSwap(Frame* frame,
+                                 ir::Type type,
+                                 ir::Value* address,
+                                 ir::Value* expected,
+                                 ir::Value* newValue)
+{
+  avian::codegen::Compiler* c = frame->c;
 
-    virtual void release()
-    {
-      s->zone.dispose();
-    }
+  ir::Value* old = c->compareAndSwap(type, address, 0, expected, newValue);
 
-    Stack* s;
-  };
+  // compute the result in an integer type as wide as the operands,
+  // since an int can't be truncated from a word-sized type:
+  bool wide = type == ir::Type::i8()
+              or (type == ir::Type::object() and TargetBytesPerWord == 8);
+  ir::Type opType = wide ? ir::Type::i8() : ir::Type::i4();
 
-  Stack(MyThread* t) : thread(t), zone(t->m->heap, 0), resource(this)
-  {
-  }
+  ir::Value* difference = c->binaryOp(lir::Xor, opType, expected, old);
 
-  ~Stack()
-  {
-    zone.dispose();
-  }
+  ir::Value* result = c->binaryOp(
+      lir::Xor,
+      opType,
+      c->constant(1, opType),
+      c->binaryOp(lir::UnsignedShiftRight,
+                  opType,
+                  c->constant(wide ? 63 : 31, ir::Type::i4()),
+                  c->binaryOp(lir::Or,
+                              opType,
+                              c->unaryOp(lir::Negate, difference),
+                              difference)));
 
-  void pushValue(uintptr_t v)
-  {
-    *static_cast<uintptr_t*>(push(BytesPerWord)) = v;
-  }
+  return wide ? c->truncate(ir::Type::i4(), result) : result;
+}
 
-  uintptr_t peekValue(unsigned offset)
-  {
-    return *static_cast<uintptr_t*>(peek((offset + 1) * BytesPerWord));
-  }
+// compiles a call to sun.misc.Unsafe.compareAndSwapObject or
+// avian.Atomic.compareAndSwapObject, the former having a receiver
+void compileCompareAndSwapObject(MyThread* t, Frame* frame, bool receiver)
+{
+  ir::Value* newValue = frame->pop(ir::Type::object());
+  ir::Value* expected = frame->pop(ir::Type::object());
 
-  uintptr_t popValue()
-  {
-    uintptr_t v = peekValue(0);
-    pop(BytesPerWord);
-    return v;
+  ir::Value* object;
+  ir::Value* offset;
+  ir::Value* address = popUnsafeAddress(frame, &object, &offset);
+  if (receiver) {
+    frame->pop(ir::Type::object());
   }
 
-  void* push(unsigned size)
-  {
-    return zone.allocate(size);
-  }
+  ir::Value* result = compileCompareAndSwap(
+      frame, ir::Type::object(), address, expected, newValue);
 
-  void* peek(unsigned size)
-  {
-    return zone.peek(size);
-  }
+  // we mark the card whether or not the swap succeeded, which is
+  // harmless if it didn't:
+  markReference(t, frame, object, offset);
 
-  void pop(unsigned size)
+  frame->push(ir::Type::i4(), result);
+}
+
+bool intrinsicSquareRoot(MyThread*, Frame* frame, GcMethod*)
+{
+  frame->pushLarge(ir::Type::f8(),
+                   frame->c->unaryOp(lir::FloatSquareRoot,
+                                     frame->popLarge(ir::Type::f8())));
+  return true;
+}
+
+bool intrinsicAbsolute(MyThread*, Frame* frame, GcMethod* target)
+{
+  avian::codegen::Compiler* c = frame->c;
+  switch (target->spec()->body()[1]) {
+  case 'I':
+    frame->push(ir::Type::i4(),
+                c->unaryOp(lir::Absolute, frame->pop(ir::Type::i4())));
+    return true;
+
+  case 'J':
+    frame->pushLarge(
+        ir::Type::i8(),
+        c->unaryOp(lir::Absolute, frame->popLarge(ir::Type::i8())));
+    return true;
+
+  case 'F':
+    frame->push(ir::Type::f4(),
+                c->unaryOp(lir::FloatAbsolute, frame->pop(ir::Type::f4())));
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+// calls a thunk which applies the C library function of the same
+// name to a double, which is cheaper than going through JNI since the
+// thunk neither blocks nor throws and so needs no state transition
+bool compileDoubleThunk(MyThread* t, Frame* frame, Thunk thunk)
+{
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* a = frame->popLarge(ir::Type::f8());
+  frame->pushLarge(ir::Type::f8(),
+                   c->nativeCall(c->constant(getThunk(t, thunk),
+                                             ir::Type::iptr()),
+                                 0,
+                                 0,
+                                 ir::Type::f8(),
+                                 args(nullptr, a)));
+  return true;
+}
+
+bool intrinsicSine(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileDoubleThunk(t, frame, sineDoubleThunk);
+}
+
+bool intrinsicCosine(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileDoubleThunk(t, frame, cosineDoubleThunk);
+}
+
+bool intrinsicTangent(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileDoubleThunk(t, frame, tangentDoubleThunk);
+}
+
+bool intrinsicExponent(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileDoubleThunk(t, frame, exponentDoubleThunk);
+}
+
+bool intrinsicLogarithm(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileDoubleThunk(t, frame, logarithmDoubleThunk);
+}
+
+bool intrinsicPower(MyThread* t, Frame* frame, GcMethod*)
+{
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* b = frame->popLarge(ir::Type::f8());
+  ir::Value* a = frame->popLarge(ir::Type::f8());
+  frame->pushLarge(ir::Type::f8(),
+                   c->nativeCall(c->constant(getThunk(t, powerDoubleThunk),
+                                             ir::Type::iptr()),
+                                 0,
+                                 0,
+                                 ir::Type::f8(),
+                                 args(nullptr, b, nullptr, a)));
+  return true;
+}
+
+// compiles a call to one of the java.lang.Integer bit twiddling
+// methods as a single instruction if the target has one, declining
+// otherwise so the bytecode implementation is used instead
+bool compileBitOperation(MyThread* t, Frame* frame, lir::BinaryOperation op)
+{
+  OperandMask mask;
+  bool thunk;
+  t->arch->planSource(op, 4, mask, 4, &thunk);
+  if (thunk) {
+    return false;
+  }
+
+  frame->push(ir::Type::i4(),
+              frame->c->unaryOp(op, frame->pop(ir::Type::i4())));
+  return true;
+}
+
+bool intrinsicBitCount(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileBitOperation(t, frame, lir::PopCount);
+}
+
+bool intrinsicLeadingZeros(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileBitOperation(t, frame, lir::LeadingZeros);
+}
+
+bool intrinsicReverseBytes(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileBitOperation(t, frame, lir::ByteSwap);
+}
+
+bool intrinsicArrayCopy(MyThread* t, Frame* frame, GcMethod*)
+{
+  // call the runtime copy routine directly rather than via a native
+  // method invocation, leaving the arguments on the stack where it
+  // can find them:
+  avian::codegen::Compiler* c = frame->c;
+  Context* context = frame->context;
+  unsigned offset
+      = localOffset(t,
+                    localSize(t, context->method) + c->topOfStack(),
+                    context->method) + t->arch->frameReturnAddressSize();
+
+  c->nativeCall(c->constant(getThunk(t, copyArrayThunk), ir::Type::iptr()),
+                0,
+                frame->trace(0, 0),
+                ir::Type::void_(),
+                args(c->threadRegister(), c->constant(offset, ir::Type::i4())));
+
+  frame->popFootprint(5);
+  return true;
+}
+
+// compiles a call to one of the sun.misc.Unsafe methods which read
+// raw memory at a long address, e.g. getInt(J)I
+bool intrinsicGetRaw(MyThread* t, Frame* frame, GcMethod* target)
+{
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* address = popLongAddress(frame);
+  frame->pop(ir::Type::object());
+
+  switch (target->spec()->body()[4]) {
+  case 'B':
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(address, ir::Type::i1()),
+                        ir::Type::i4()));
+    break;
+
+  case 'S':
+  case 'C':
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(address, ir::Type::i2()),
+                        ir::Type::i4()));
+    break;
+
+  case 'I':
+  case 'F': {
+    ir::Type type = target->spec()->body()[4] == 'I' ? ir::Type::i4()
+                                                     : ir::Type::f4();
+    frame->push(
+        type, c->load(ir::ExtendMode::Signed, c->memory(address, type), type));
+  } break;
+
+  case 'J':
+  case 'D': {
+    ir::Type type = target->spec()->body()[4] == 'J' ? ir::Type::i8()
+                                                     : ir::Type::f8();
+    frame->pushLarge(
+        type, c->load(ir::ExtendMode::Signed, c->memory(address, type), type));
+  } break;
+
+  default:
+    abort(t);
+  }
+
+  return true;
+}
+
+// compiles a call to one of the sun.misc.Unsafe methods which write
+// raw memory at a long address, e.g. putInt(JI)V
+bool intrinsicPutRaw(MyThread* t, Frame* frame, GcMethod* target)
+{
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* value;
+  ir::Type type = ir::Type::void_();
+  switch (target->spec()->body()[2]) {
+  case 'B':
+    value = frame->pop(ir::Type::i4());
+    type = ir::Type::i1();
+    break;
+
+  case 'S':
+  case 'C':
+    value = frame->pop(ir::Type::i4());
+    type = ir::Type::i2();
+    break;
+
+  case 'I':
+  case 'F':
+    type = target->spec()->body()[2] == 'I' ? ir::Type::i4() : ir::Type::f4();
+    value = frame->pop(type);
+    break;
+
+  case 'J':
+  case 'D':
+    type = target->spec()->body()[2] == 'J' ? ir::Type::i8() : ir::Type::f8();
+    value = frame->popLarge(type);
+    break;
+
+  default:
+    abort(t);
+  }
+
+  ir::Value* address = popLongAddress(frame);
+  frame->pop(ir::Type::object());
+  c->store(value, c->memory(address, type));
+  return true;
+}
+
+bool intrinsicGetAddress(MyThread*, Frame* frame, GcMethod*)
+{
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* address = popLongAddress(frame);
+  frame->pop(ir::Type::object());
+  frame->pushLarge(ir::Type::i8(),
+                   c->load(ir::ExtendMode::Signed,
+                           c->memory(address, ir::Type::iptr()),
+                           ir::Type::i8()));
+  return true;
+}
+
+bool intrinsicPutAddress(MyThread*, Frame* frame, GcMethod*)
+{
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* value = frame->popLarge(ir::Type::i8());
+  ir::Value* address = popLongAddress(frame);
+  frame->pop(ir::Type::object());
+  c->store(value, c->memory(address, ir::Type::iptr()));
+  return true;
+}
+
+bool intrinsicGetVolatile(MyThread*, Frame* frame, GcMethod* target)
+{
+  char code = target->spec()->body()[target->spec()->length() - 2];
+  if (code == 'J' and TargetBytesPerWord != 8) {
+    return false;
+  }
+
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* object;
+  ir::Value* offset;
+  ir::Value* address = popUnsafeAddress(frame, &object, &offset);
+  frame->pop(ir::Type::object());
+
+  switch (code) {
+  case 'I':
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(address, ir::Type::i4()),
+                        ir::Type::i4()));
+    break;
+
+  case 'J':
+    frame->pushLarge(ir::Type::i8(),
+                     c->load(ir::ExtendMode::Signed,
+                             c->memory(address, ir::Type::i8()),
+                             ir::Type::i8()));
+    break;
+
+  default:
+    frame->push(ir::Type::object(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(address, ir::Type::object()),
+                        ir::Type::object()));
+    break;
+  }
+
+  c->nullaryOp(lir::LoadBarrier);
+  return true;
+}
+
+// compiles a call to sun.misc.Unsafe.put*Volatile or putOrdered*.  An
+// ordered store need only not be reordered with earlier stores,
+// whereas a volatile one must also precede later loads.
+bool compilePutVolatile(MyThread* t,
+                        Frame* frame,
+                        GcMethod* target,
+                        bool ordered)
+{
+  char code = target->spec()->body()[target->spec()->length() - 4];
+  if (code == 'J' and TargetBytesPerWord != 8) {
+    return false;
+  }
+
+  avian::codegen::Compiler* c = frame->c;
+  ir::Value* value;
+  switch (code) {
+  case 'I':
+    value = frame->pop(ir::Type::i4());
+    break;
+
+  case 'J':
+    value = frame->popLarge(ir::Type::i8());
+    break;
+
+  default:
+    value = frame->pop(ir::Type::object());
+    break;
+  }
+
+  ir::Value* object;
+  ir::Value* offset;
+  ir::Value* address = popUnsafeAddress(frame, &object, &offset);
+  frame->pop(ir::Type::object());
+
+  c->nullaryOp(lir::StoreStoreBarrier);
+
+  if (value->type == ir::Type::object()) {
+    storeReference(t,
+                   frame,
+                   object,
+                   offset,
+                   c->memory(address, ir::Type::object()),
+                   value);
+  } else {
+    c->store(value, c->memory(address, value->type));
+  }
+
+  if (not ordered) {
+    c->nullaryOp(lir::StoreLoadBarrier);
+  }
+  return true;
+}
+
+bool intrinsicPutVolatile(MyThread* t, Frame* frame, GcMethod* target)
+{
+  return compilePutVolatile(t, frame, target, false);
+}
+
+bool intrinsicPutOrdered(MyThread* t, Frame* frame, GcMethod* target)
+{
+  return compilePutVolatile(t, frame, target, true);
+}
+
+bool compileCompareAndSwapIntegral(MyThread* t, Frame* frame, ir::Type type)
+{
+  if (not inlineCompareAndSwap(t, type == ir::Type::i4() ? 4 : 8)) {
+    return false;
+  }
+
+  ir::Value* newValue;
+  ir::Value* expected;
+  if (type == ir::Type::i4()) {
+    newValue = frame->pop(type);
+    expected = frame->pop(type);
+  } else {
+    newValue = frame->popLarge(type);
+    expected = frame->popLarge(type);
+  }
+
+  ir::Value* object;
+  ir::Value* offset;
+  ir::Value* address = popUnsafeAddress(frame, &object, &offset);
+  frame->pop(ir::Type::object());
+
+  frame->push(ir::Type::i4(),
+              compileCompareAndSwap(frame, type, address, expected, newValue));
+  return true;
+}
+
+bool intrinsicCompareAndSwapInt(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileCompareAndSwapIntegral(t, frame, ir::Type::i4());
+}
+
+bool intrinsicCompareAndSwapLong(MyThread* t, Frame* frame, GcMethod*)
+{
+  return compileCompareAndSwapIntegral(t, frame, ir::Type::i8());
+}
+
+bool intrinsicCompareAndSwapObject(MyThread* t, Frame* frame, GcMethod*)
+{
+  if (not inlineCompareAndSwap(t, TargetBytesPerWord)) {
+    return false;
+  }
+
+  compileCompareAndSwapObject(t, frame, true);
+  return true;
+}
+
+bool intrinsicAtomicCompareAndSwapObject(MyThread* t, Frame* frame, GcMethod*)
+{
+  if (not inlineCompareAndSwap(t, TargetBytesPerWord)) {
+    return false;
+  }
+
+  compileCompareAndSwapObject(t, frame, false);
+  return true;
+}
+
+// an intrinsic is compiled in place of a call to the method it
+// names; its compile function may decline, leaving the call as is:
+class Intrinsic {
+ public:
+  const char* name;
+  const char* spec;
+  bool (*compile)(MyThread* t, Frame* frame, GcMethod* target);
+};
+
+const Intrinsic mathIntrinsics[] = {
+    {"sqrt", "(D)D", intrinsicSquareRoot},
+    {"abs", "(I)I", intrinsicAbsolute},
+    {"abs", "(J)J", intrinsicAbsolute},
+    {"abs", "(F)F", intrinsicAbsolute},
+    {"sin", "(D)D", intrinsicSine},
+    {"cos", "(D)D", intrinsicCosine},
+    {"tan", "(D)D", intrinsicTangent},
+    {"exp", "(D)D", intrinsicExponent},
+    {"log", "(D)D", intrinsicLogarithm},
+    {"pow", "(DD)D", intrinsicPower}};
+
+const Intrinsic integerIntrinsics[] = {
+    {"bitCount", "(I)I", intrinsicBitCount},
+    {"numberOfLeadingZeros", "(I)I", intrinsicLeadingZeros},
+    {"reverseBytes", "(I)I", intrinsicReverseBytes}};
+
+const Intrinsic systemIntrinsics[] = {
+    {"arraycopy",
+     "(Ljava/lang/Object;ILjava/lang/Object;II)V",
+     intrinsicArrayCopy}};
+
+const Intrinsic unsafeIntrinsics[] = {
+    {"getByte", "(J)B", intrinsicGetRaw},
+    {"putByte", "(JB)V", intrinsicPutRaw},
+    {"getShort", "(J)S", intrinsicGetRaw},
+    {"putShort", "(JS)V", intrinsicPutRaw},
+    {"getChar", "(J)C", intrinsicGetRaw},
+    {"putChar", "(JC)V", intrinsicPutRaw},
+    {"getInt", "(J)I", intrinsicGetRaw},
+    {"putInt", "(JI)V", intrinsicPutRaw},
+    {"getFloat", "(J)F", intrinsicGetRaw},
+    {"putFloat", "(JF)V", intrinsicPutRaw},
+    {"getLong", "(J)J", intrinsicGetRaw},
+    {"putLong", "(JJ)V", intrinsicPutRaw},
+    {"getDouble", "(J)D", intrinsicGetRaw},
+    {"putDouble", "(JD)V", intrinsicPutRaw},
+    {"getAddress", "(J)J", intrinsicGetAddress},
+    {"putAddress", "(JJ)V", intrinsicPutAddress},
+    {"getIntVolatile", "(Ljava/lang/Object;J)I", intrinsicGetVolatile},
+    {"getLongVolatile", "(Ljava/lang/Object;J)J", intrinsicGetVolatile},
+    {"getObjectVolatile",
+     "(Ljava/lang/Object;J)Ljava/lang/Object;",
+     intrinsicGetVolatile},
+    {"putIntVolatile", "(Ljava/lang/Object;JI)V", intrinsicPutVolatile},
+    {"putLongVolatile", "(Ljava/lang/Object;JJ)V", intrinsicPutVolatile},
+    {"putObjectVolatile",
+     "(Ljava/lang/Object;JLjava/lang/Object;)V",
+     intrinsicPutVolatile},
+    {"putOrderedInt", "(Ljava/lang/Object;JI)V", intrinsicPutOrdered},
+    {"putOrderedLong", "(Ljava/lang/Object;JJ)V", intrinsicPutOrdered},
+    {"putOrderedObject",
+     "(Ljava/lang/Object;JLjava/lang/Object;)V",
+     intrinsicPutOrdered},
+    {"compareAndSwapInt",
+     "(Ljava/lang/Object;JII)Z",
+     intrinsicCompareAndSwapInt},
+    {"compareAndSwapLong",
+     "(Ljava/lang/Object;JJJ)Z",
+     intrinsicCompareAndSwapLong},
+    {"compareAndSwapObject",
+     "(Ljava/lang/Object;JLjava/lang/Object;Ljava/lang/Object;)Z",
+     intrinsicCompareAndSwapObject}};
+
+const Intrinsic atomicIntrinsics[] = {
+    {"compareAndSwapObject",
+     "(Ljava/lang/Object;JLjava/lang/Object;Ljava/lang/Object;)Z",
+     intrinsicAtomicCompareAndSwapObject}};
+
+// intrinsics are grouped by class so that, for most methods, only
+// the class name need be compared:
+class IntrinsicClass {
+ public:
+  const char* name;
+  const Intrinsic* intrinsics;
+  unsigned count;
+};
+
+const IntrinsicClass intrinsicClasses[] = {
+    {"java/lang/Math",
+     mathIntrinsics,
+     sizeof(mathIntrinsics) / sizeof(Intrinsic)},
+    {"java/lang/Integer",
+     integerIntrinsics,
+     sizeof(integerIntrinsics) / sizeof(Intrinsic)},
+    {"java/lang/System",
+     systemIntrinsics,
+     sizeof(systemIntrinsics) / sizeof(Intrinsic)},
+    {"sun/misc/Unsafe",
+     unsafeIntrinsics,
+     sizeof(unsafeIntrinsics) / sizeof(Intrinsic)},
+    {"avian/Atomic",
+     atomicIntrinsics,
+     sizeof(atomicIntrinsics) / sizeof(Intrinsic)}};
+
+const unsigned IntrinsicClassCount = sizeof(intrinsicClasses)
+                                     / sizeof(IntrinsicClass);
+
+bool matches(GcByteArray* array, const char* string)
+{
+  return array->length() == strlen(string) + 1
+         and ::strcmp(reinterpret_cast<char*>(array->body().begin()), string)
+             == 0;
+}
+
+bool intrinsic(MyThread* t, Frame* frame, GcMethod* target)
+{
+  GcByteArray* className = target->class_()->name();
+  for (unsigned i = 0; i < IntrinsicClassCount; ++i) {
+    const IntrinsicClass* c = intrinsicClasses + i;
+    if (UNLIKELY(matches(className, c->name))) {
+      for (unsigned j = 0; j < c->count; ++j) {
+        const Intrinsic* p = c->intrinsics + j;
+        if (matches(target->name(), p->name)
+            and matches(target->spec(), p->spec)) {
+          return p->compile(t, frame, target);
+        }
+      }
+      return false;
+    }
+  }
+
+  return false;
+}
+
+unsigned targetFieldOffset(Context* context, GcField* field)
+{
+  if (context->bootContext) {
+    return context->bootContext->resolver->fieldOffset(context->thread, field);
+  } else {
+    return field->offset();
+  }
+}
+
+class Stack {
+ public:
+  class MyResource : public Thread::AutoResource {
+   public:
+    MyResource(Stack* s) : AutoResource(s->thread), s(s)
+    {
+    }
+
+    virtual void release()
+    {
+      s->zone.dispose();
+    }
+
+    Stack* s;
+  };
+
+  Stack(MyThread* t) : thread(t), zone(t->m->heap, 0), resource(this)
+  {
+  }
+
+  ~Stack()
+  {
+    zone.dispose();
+  }
+
+  void pushValue(uintptr_t v)
+  {
+    *static_cast<uintptr_t*>(push(BytesPerWord)) = v;
+  }
+
+  uintptr_t peekValue(unsigned offset)
+  {
+    return *static_cast<uintptr_t*>(peek((offset + 1) * BytesPerWord));
+  }
+
+  uintptr_t popValue()
+  {
+    uintptr_t v = peekValue(0);
+    pop(BytesPerWord);
+    return v;
+  }
+
+  void* push(unsigned size)
+  {
+    return zone.allocate(size);
+  }
+
+  void* peek(unsigned size)
+  {
+    return zone.peek(size);
+  }
+
+  void pop(unsigned size)
   {
     zone.pop(size);
   }
@@ -4063,12 +5234,389 @@ bool isLambda(Thread* t,
                           bootstrap->spec()->body().begin()) == 0));
 }
 
+// allocates sizeInWords (an i4 value) words from the thread-local
+// heap, sets the class of the result to class_, and returns it.  If
+// the allocation won't fit, or if check (also i4) is negative, the
+// specified thunk is called to allocate the object instead.
+// Returns true if objects may be allocated from the thread-local heap
+// inline.  Stress builds force a collection at each allocation, which
+// only the thunks do, so they always call them.
+bool inlineAllocations()
+{
+#ifdef VM_STRESS
+  return false;
+#else
+  return true;
+#endif
+}
+
+ir::Value* compileAllocation(MyThread* t,
+                             Frame* frame,
+                             ir::Value* sizeInWords,
+                             ir::Value* check,
+                             GcClass* class_,
+                             Thunk thunk,
+                             Slice<ir::Value*> arguments)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  if (not inlineAllocations()) {
+    return c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                         0,
+                         frame->trace(0, 0),
+                         ir::Type::object(),
+                         arguments);
+  }
+
+  ir::Value* index = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(c->threadRegister(), ir::Type::i4(), TARGET_THREAD_HEAPINDEX),
+      ir::Type::i4());
+
+  // negative if we must take the slow path:
+  ir::Value* room = c->binaryOp(
+      lir::Subtract,
+      ir::Type::i4(),
+      c->binaryOp(lir::Add, ir::Type::i4(), sizeInWords, index),
+      c->constant(ThreadHeapSizeInBytes / TargetBytesPerWord, ir::Type::i4()));
+
+  if (check) {
+    room = c->binaryOp(lir::Or, ir::Type::i4(), check, room);
+  }
+
+  // bump the heap index only if we're taking the fast path, leaving
+  // it for the thunk to update otherwise:
+  c->store(
+      c->binaryOp(
+          lir::Add,
+          ir::Type::i4(),
+          index,
+          c->binaryOp(lir::And,
+                      ir::Type::i4(),
+                      sizeInWords,
+                      c->binaryOp(lir::ShiftRight,
+                                  ir::Type::i4(),
+                                  c->constant(31, ir::Type::i4()),
+                                  c->binaryOp(lir::Xor,
+                                              ir::Type::i4(),
+                                              c->constant(-1, ir::Type::i4()),
+                                              room)))),
+      c->memory(c->threadRegister(), ir::Type::i4(), TARGET_THREAD_HEAPINDEX));
+
+  ir::Value* fast = c->binaryOp(
+      lir::Add,
+      ir::Type::object(),
+      c->memory(c->threadRegister(), ir::Type::object(), TARGET_THREAD_HEAP),
+      c->binaryOp(lir::ShiftLeft,
+                  ir::Type::iptr(),
+                  c->constant(log(TargetBytesPerWord), ir::Type::i4()),
+                  c->truncateThenExtend(ir::ExtendMode::Signed,
+                                        ir::Type::iptr(),
+                                        ir::Type::i4(),
+                                        index)));
+
+  ir::Value* result = c->guardedNativeCall(
+      lir::JumpIfLess,
+      c->constant(0, ir::Type::i4()),
+      room,
+      fast,
+      c->constant(getThunk(t, thunk), ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      ir::Type::object(),
+      arguments);
+
+  // the thread-local heap is zeroed in advance, so the header is all
+  // we need to fill in here, preserving any mark bits the thunk may
+  // have set, as setObjectClass does:
+  c->store(c->binaryOp(
+               lir::Or,
+               ir::Type::iptr(),
+               frame->append(class_),
+               c->binaryOp(lir::And,
+                           ir::Type::iptr(),
+                           c->constant(~TargetPointerMask, ir::Type::iptr()),
+                           c->load(ir::ExtendMode::Signed,
+                                   c->memory(result, ir::Type::iptr(), 0),
+                                   ir::Type::iptr()))),
+           c->memory(result, ir::Type::iptr(), 0));
+
+  return result;
+}
+
+// allocates an array of length (an i4 value) elements of
+// elementSizeInBytes each, using thunk as the slow path
+ir::Value* compileArrayAllocation(MyThread* t,
+                                  Frame* frame,
+                                  ir::Value* length,
+                                  unsigned elementSizeInBytes,
+                                  GcClass* class_,
+                                  Thunk thunk,
+                                  Slice<ir::Value*> arguments)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  if (not inlineAllocations()) {
+    return c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                         0,
+                         frame->trace(0, 0),
+                         ir::Type::object(),
+                         arguments);
+  }
+
+  // a negative length, or one too large to fit in an empty
+  // thread-local heap, makes check negative and sends us to the
+  // thunk, which will either throw or allocate the array elsewhere:
+  ir::Value* check = c->binaryOp(
+      lir::Or,
+      ir::Type::i4(),
+      length,
+      c->binaryOp(
+          lir::Subtract,
+          ir::Type::i4(),
+          length,
+          c->constant(
+              (ThreadHeapSizeInBytes - TargetArrayBody) / elementSizeInBytes,
+              ir::Type::i4())));
+
+  ir::Value* sizeInWords = c->binaryOp(
+      lir::ShiftRight,
+      ir::Type::i4(),
+      c->constant(log(TargetBytesPerWord), ir::Type::i4()),
+      c->binaryOp(
+          lir::Add,
+          ir::Type::i4(),
+          c->constant(TargetArrayBody + TargetBytesPerWord - 1,
+                      ir::Type::i4()),
+          c->binaryOp(lir::ShiftLeft,
+                      ir::Type::i4(),
+                      c->constant(log(elementSizeInBytes), ir::Type::i4()),
+                      length)));
+
+  ir::Value* result = compileAllocation(
+      t, frame, sizeInWords, check, class_, thunk, arguments);
+
+  c->store(c->truncateThenExtend(ir::ExtendMode::Signed,
+                                 ir::Type::iptr(),
+                                 ir::Type::i4(),
+                                 length),
+           c->memory(result, ir::Type::iptr(), TargetArrayLength));
+
+  return result;
+}
+
+// stores value to the specified field or element of object, then
+// records the store in the heap's card table, or via Heap::mark if
+// object is fixed
+void storeReference(MyThread* t,
+                    Frame* frame,
+                    ir::Value* object,
+                    ir::Value* offset,
+                    ir::Value* dst,
+                    ir::Value* value)
+{
+  frame->c->store(value, dst);
+
+  markReference(t, frame, object, offset);
+}
+
+void markReference(MyThread* t,
+                   Frame* frame,
+                   ir::Value* object,
+                   ir::Value* offset)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  ir::Value* table = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(c->threadRegister(), ir::Type::iptr(), TARGET_THREAD_CARDTABLE),
+      ir::Type::iptr());
+
+  ir::Value* start = c->load(ir::ExtendMode::Signed,
+                             c->memory(table, ir::Type::iptr(), 0),
+                             ir::Type::iptr());
+
+  // an object below start yields a huge unsigned difference, so a
+  // single signed comparison against count suffices:
+  ir::Value* index = c->binaryOp(
+      lir::UnsignedShiftRight,
+      ir::Type::iptr(),
+      c->constant(LogCardSizeInBytes, ir::Type::i4()),
+      c->binaryOp(lir::Subtract, ir::Type::iptr(), start, object));
+
+  c->markCard(index,
+              c->load(ir::ExtendMode::Signed,
+                      c->memory(table, ir::Type::iptr(), TargetBytesPerWord),
+                      ir::Type::iptr()),
+              c->load(ir::ExtendMode::Signed,
+                      c->memory(table,
+                                ir::Type::iptr(),
+                                TargetBytesPerWord * 2),
+                      ir::Type::iptr()));
+
+  ir::Value* mark = c->binaryOp(
+      lir::And,
+      ir::Type::iptr(),
+      c->constant(FixedMark, ir::Type::iptr()),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(object, ir::Type::iptr(), 0),
+              ir::Type::iptr()));
+
+  c->guardedNativeCall(
+      lir::JumpIfEqual,
+      c->constant(FixedMark, ir::Type::iptr()),
+      mark,
+      0,
+      c->constant(getThunk(t, markFixedThunk), ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      ir::Type::void_(),
+      args(c->threadRegister(), object, offset));
+}
+
+// Compiles a call to target by substituting its body, provided target
+// is a trivial instance method: a getter which returns a field of its
+// receiver, or a setter which stores its sole argument to such a
+// field.  The caller must ensure the call is statically bound.
+// Returns false if target is not trivial (or its field cannot be
+// resolved yet), in which case nothing is emitted; empty methods are
+// left to compileDirectInvoke.
+//
+// Since the inlined body makes no calls, it needs no trace of its
+// own; a null receiver faults on the field access just as a getfield
+// or putfield in the caller would, and so is reported as a
+// NullPointerException thrown by the caller.
+bool inlineTrivialMethod(MyThread* t,
+                         Frame* frame,
+                         GcMethod* target,
+                         bool tryBlock)
+{
+  if ((target->flags()
+       & (ACC_STATIC | ACC_NATIVE | ACC_ABSTRACT | ACC_SYNCHRONIZED))
+      or target->code() == 0) {
+    return false;
+  }
+
+  avian::codegen::Compiler* c = frame->c;
+  Context* context = frame->context;
+  GcCode* code = target->code();
+  uint8_t* body = code->body().begin();
+
+  bool getter = code->length() == 5 and body[0] == aload_0
+                and body[1] == getfield and body[4] >= ireturn
+                and body[4] <= areturn;
+
+  bool setter = code->length() == 6 and body[0] == aload_0
+                and (body[1] == iload_1 or body[1] == lload_1
+                     or body[1] == fload_1 or body[1] == dload_1
+                     or body[1] == aload_1) and body[2] == putfield
+                and body[5] == return_;
+
+  if (not(getter or setter)) {
+    return false;
+  }
+
+  unsigned index = getter ? (body[2] << 8) | body[3] : (body[3] << 8) | body[4];
+
+  GcField* field = resolveField(t, target, index - 1, false);
+
+  if (field == 0 or (field->flags() & (ACC_STATIC | ACC_VOLATILE))) {
+    return false;
+  }
+
+  unsigned offset = targetFieldOffset(context, field);
+
+  if (getter) {
+    ir::Value* instance = frame->pop(ir::Type::object());
+
+    if (tryBlock) {
+      c->saveLocals();
+      frame->trace(0, 0);
+    }
+
+    ir::Type type = ir::Type::i4();
+    ir::ExtendMode extend = ir::ExtendMode::Signed;
+    switch (field->code()) {
+    case ByteField:
+    case BooleanField:
+      type = ir::Type::i1();
+      break;
+
+    case CharField:
+      type = ir::Type::i2();
+      extend = ir::ExtendMode::Unsigned;
+      break;
+
+    case ShortField:
+      type = ir::Type::i2();
+      break;
+
+    case IntField:
+      break;
+
+    default:
+      type = operandTypeForFieldCode(t, field->code());
+    }
+
+    frame->pushReturnValue(
+        field->code(),
+        c->load(extend,
+                c->memory(instance, type, offset),
+                operandTypeForFieldCode(t, field->code())));
+  } else {
+    if (tryBlock) {
+      c->saveLocals();
+      frame->trace(0, 0);
+    }
+
+    ir::Value* value = popField(t, frame, field->code());
+    ir::Value* instance = frame->pop(ir::Type::object());
+
+    switch (field->code()) {
+    case ByteField:
+    case BooleanField:
+      c->store(value, c->memory(instance, ir::Type::i1(), offset));
+      break;
+
+    case CharField:
+    case ShortField:
+      c->store(value, c->memory(instance, ir::Type::i2(), offset));
+      break;
+
+    case ObjectField:
+      storeReference(t,
+                     frame,
+                     instance,
+                     c->constant(offset, ir::Type::i4()),
+                     c->memory(instance, ir::Type::object(), offset),
+                     value);
+      break;
+
+    default:
+      c->store(value,
+               c->memory(instance,
+                         operandTypeForFieldCode(t, field->code()),
+                         offset));
+    }
+  }
+
+  return true;
+}
+
 void compile(MyThread* t,
              Frame* initialFrame,
              unsigned initialIp,
              int exceptionHandlerStart = -1)
 {
-  enum { Return, Unbranch, Unsubroutine, Untable0, Untable1, Unswitch };
+  enum {
+    Return,
+    Unbranch,
+    Unsubroutine,
+    Untable0,
+    Untable1,
+    Unswitch,
+    Unlookup
+  };
 
   Frame* frame = initialFrame;
   avian::codegen::Compiler* c = frame->c;
@@ -4156,7 +5704,7 @@ loop:
         frame->trace(0, 0);
       }
 
-      if (CheckArrayBounds) {
+      if (CheckArrayBounds and not context->uncheckedArrayAccess(ip - 1)) {
         c->checkBounds(array, TargetArrayLength, index, aioobThunk(t));
       }
 
@@ -4257,28 +5805,26 @@ loop:
         frame->trace(0, 0);
       }
 
-      if (CheckArrayBounds) {
+      if (CheckArrayBounds and not context->uncheckedArrayAccess(ip - 1)) {
         c->checkBounds(array, TargetArrayLength, index, aioobThunk(t));
       }
 
       switch (instruction) {
       case aastore: {
-        c->nativeCall(
-            c->constant(getThunk(t, setMaybeNullThunk), ir::Type::iptr()),
-            0,
-            frame->trace(0, 0),
-            ir::Type::void_(),
-            args(c->threadRegister(),
-                 array,
-                 c->binaryOp(lir::Add,
-                             ir::Type::i4(),
-                             c->constant(TargetArrayBody, ir::Type::i4()),
-                             c->binaryOp(lir::ShiftLeft,
-                                         ir::Type::i4(),
-                                         c->constant(log(TargetBytesPerWord),
-                                                     ir::Type::i4()),
-                                         index)),
-                 value));
+        storeReference(
+            t,
+            frame,
+            array,
+            c->binaryOp(lir::Add,
+                        ir::Type::i4(),
+                        c->constant(TargetArrayBody, ir::Type::i4()),
+                        c->binaryOp(lir::ShiftLeft,
+                                    ir::Type::i4(),
+                                    c->constant(log(TargetBytesPerWord),
+                                                ir::Type::i4()),
+                                    index)),
+            c->memory(array, ir::Type::object(), TargetArrayBody, index),
+            value);
       } break;
 
       case fastore:
@@ -4351,24 +5897,35 @@ loop:
 
       ir::Value* length = frame->pop(ir::Type::i4());
 
-      object argument;
-      Thunk thunk;
       if (LIKELY(class_)) {
-        argument = class_;
-        thunk = makeBlankObjectArrayThunk;
+        PROTECT(t, class_);
+
+        GcClass* arrayClass
+            = resolveObjectArrayClass(t, class_->loader(), class_);
+
+        frame->push(ir::Type::object(),
+                    compileArrayAllocation(t,
+                                           frame,
+                                           length,
+                                           TargetBytesPerWord,
+                                           arrayClass,
+                                           makeBlankObjectArrayThunk,
+                                           args(c->threadRegister(),
+                                                frame->append(class_),
+                                                length)));
       } else {
-        argument = makePair(t, context->method, reference);
-        thunk = makeBlankObjectArrayFromReferenceThunk;
-      }
+        object argument = makePair(t, context->method, reference);
 
-      frame->push(
-          ir::Type::object(),
-          c->nativeCall(
-              c->constant(getThunk(t, thunk), ir::Type::iptr()),
-              0,
-              frame->trace(0, 0),
-              ir::Type::object(),
-              args(c->threadRegister(), frame->append(argument), length)));
+        frame->push(
+            ir::Type::object(),
+            c->nativeCall(
+                c->constant(getThunk(t, makeBlankObjectArrayFromReferenceThunk),
+                            ir::Type::iptr()),
+                0,
+                frame->trace(0, 0),
+                ir::Type::object(),
+                args(c->threadRegister(), frame->append(argument), length)));
+      }
     } break;
 
     case areturn: {
@@ -4447,12 +6004,21 @@ loop:
 
       ir::Value* instance = c->peek(1, 0);
 
-      c->nativeCall(
-          c->constant(getThunk(t, thunk), ir::Type::iptr()),
-          0,
-          frame->trace(0, 0),
-          ir::Type::void_(),
-          args(c->threadRegister(), frame->append(argument), instance));
+      if (class_ and TargetBytesPerWord == BytesPerWord) {
+        compileTypeCheck(t,
+                         frame,
+                         class_,
+                         instance,
+                         checkCastAndCacheThunk,
+                         ir::Type::void_());
+      } else {
+        c->nativeCall(
+            c->constant(getThunk(t, thunk), ir::Type::iptr()),
+            0,
+            frame->trace(0, 0),
+            ir::Type::void_(),
+            args(c->threadRegister(), frame->append(argument), instance));
+      }
     } break;
 
     case d2f: {
@@ -5102,14 +6668,24 @@ loop:
         thunk = instanceOfFromReferenceThunk;
       }
 
-      frame->push(
-          ir::Type::i4(),
-          c->nativeCall(
-              c->constant(getThunk(t, thunk), ir::Type::iptr()),
-              0,
-              frame->trace(0, 0),
-              ir::Type::i4(),
-              args(c->threadRegister(), frame->append(argument), instance)));
+      if (class_ and TargetBytesPerWord == BytesPerWord) {
+        frame->push(ir::Type::i4(),
+                    compileTypeCheck(t,
+                                     frame,
+                                     class_,
+                                     instance,
+                                     instanceOfAndCacheThunk,
+                                     ir::Type::i4()));
+      } else {
+        frame->push(
+            ir::Type::i4(),
+            c->nativeCall(
+                c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                0,
+                frame->trace(0, 0),
+                ir::Type::i4(),
+                args(c->threadRegister(), frame->append(argument), instance)));
+      }
     } break;
 
     case invokedynamic: {
@@ -5361,16 +6937,25 @@ loop:
         tailCall = isReferenceTailCall(t, code, ip, context->method, ref);
       }
 
-      unsigned rSize = resultSize(t, returnCode);
-
+      unsigned rSize = resultSize(t, returnCode);
+
+      ir::Value* address;
+      if (target and TargetBytesPerWord == BytesPerWord) {
+        address = compileCachedInterfaceLookup(
+            t, frame, target, c->peek(1, parameterFootprint - 1));
+      } else {
+        address = c->nativeCall(
+            c->constant(getThunk(t, thunk), ir::Type::iptr()),
+            0,
+            frame->trace(0, 0),
+            ir::Type::iptr(),
+            args(c->threadRegister(),
+                 frame->append(argument),
+                 c->peek(1, parameterFootprint - 1)));
+      }
+
       ir::Value* result = c->stackCall(
-          c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
-                        0,
-                        frame->trace(0, 0),
-                        ir::Type::iptr(),
-                        args(c->threadRegister(),
-                             frame->append(argument),
-                             c->peek(1, parameterFootprint - 1))),
+          address,
           tailCall ? Compiler::TailJump : 0,
           frame->trace(0, 0),
           operandTypeForFieldCode(t, returnCode),
@@ -5394,6 +6979,7 @@ loop:
       PROTECT(t, reference);
 
       GcMethod* target = resolveMethod(t, context->method, index - 1, false);
+      PROTECT(t, target);
 
       if (LIKELY(target)) {
         GcClass* class_ = context->method->class_();
@@ -5408,7 +6994,8 @@ loop:
         if (UNLIKELY(methodAbstract(t, target))) {
           compileDirectAbstractInvoke(
               t, frame, getMethodAddressThunk, target, tailCall);
-        } else {
+        } else if (not inlineTrivialMethod(
+                       t, frame, target, inTryBlock(t, code, ip - 3))) {
           compileDirectInvoke(t, frame, target, tailCall);
         }
       } else {
@@ -5467,32 +7054,47 @@ loop:
       PROTECT(t, reference);
 
       GcMethod* target = resolveMethod(t, context->method, index - 1, false);
+      PROTECT(t, target);
 
       if (LIKELY(target)) {
         checkMethod(t, target, false);
 
-        if (not intrinsic(t, frame, target)) {
+        if (not(intrinsic(t, frame, target)
+                or (((target->flags() & (ACC_FINAL | ACC_PRIVATE))
+                     or (target->class_()->flags() & ACC_FINAL))
+                    and inlineTrivialMethod(
+                            t, frame, target, inTryBlock(t, code, ip - 3))))) {
           bool tailCall = isTailCall(t, code, ip, context->method, target);
 
           if (LIKELY(methodVirtual(t, target))) {
-            unsigned parameterFootprint = target->parameterFootprint();
+            if (isDevirtualizable(frame, target, tailCall)) {
+              compileDevirtualizedInvoke(
+                  t,
+                  frame,
+                  target,
+                  not(target->parameterFootprint() == 1
+                      and context->selfCall(ip - 3)));
+            } else {
+              unsigned parameterFootprint = target->parameterFootprint();
 
-            unsigned offset = TargetClassVtable
-                              + (target->offset() * TargetBytesPerWord);
+              unsigned offset = TargetClassVtable
+                                + (target->offset() * TargetBytesPerWord);
 
-            ir::Value* instance = c->peek(1, parameterFootprint - 1);
+              ir::Value* instance = c->peek(1, parameterFootprint - 1);
 
-            frame->stackCall(
-                c->memory(c->binaryOp(
-                              lir::And,
-                              ir::Type::iptr(),
-                              c->constant(TargetPointerMask, ir::Type::iptr()),
-                              c->memory(instance, ir::Type::object())),
-                          ir::Type::object(),
-                          offset),
-                target,
-                tailCall ? Compiler::TailJump : 0,
-                frame->trace(0, 0));
+              frame->stackCall(
+                  c->memory(
+                      c->binaryOp(lir::And,
+                                  ir::Type::iptr(),
+                                  c->constant(TargetPointerMask,
+                                              ir::Type::iptr()),
+                                  c->memory(instance, ir::Type::object())),
+                      ir::Type::object(),
+                      offset),
+                  target,
+                  tailCall ? Compiler::TailJump : 0,
+                  frame->trace(0, 0));
+            }
           } else {
             // OpenJDK generates invokevirtual calls to private methods
             // (e.g. readObject and writeObject for serialization), so
@@ -5804,7 +7406,86 @@ loop:
 
       int32_t pairCount = codeReadInt32(t, code, ip);
 
+      int32_t bottom = 0;
+      int32_t top = 0;
       if (pairCount) {
+        unsigned index = ip;
+        bottom = codeReadInt32(t, code, index);
+        index = ip + ((pairCount - 1) * 8);
+        top = codeReadInt32(t, code, index);
+      }
+
+      if (pairCount
+          and static_cast<unsigned>(pairCount) <= LookupSwitchChainLimit) {
+        // compare the key with each case in turn, compiling the target
+        // of each comparison before moving on to the next:
+        unsigned index = ip;
+        int32_t caseKey = codeReadInt32(t, code, index);
+        uint32_t newIp = base + codeReadInt32(t, code, index);
+        assertT(t, newIp < code->length());
+
+        c->condJump(lir::JumpIfEqual,
+                    c->constant(caseKey, ir::Type::i4()),
+                    key,
+                    frame->machineIpValue(newIp));
+
+        c->save(ir::Type::i4(), key);
+
+        stack.pushValue(reinterpret_cast<uintptr_t>(c->saveState()));
+        stack.pushValue(reinterpret_cast<uintptr_t>(key));
+        stack.pushValue(base);
+        stack.pushValue(0);
+        stack.pushValue(Unlookup);
+        ip = newIp;
+        goto start;
+      } else if (pairCount
+                 and static_cast<int64_t>(top) - bottom
+                     < static_cast<int64_t>(pairCount) * 2) {
+        // the keys are dense enough to compile this as if it were a
+        // tableswitch, with any missing keys going to the default:
+        avian::codegen::Promise* start = 0;
+        unsigned count = top - bottom + 1;
+        uint32_t* ipTable
+            = static_cast<uint32_t*>(stack.push(sizeof(uint32_t) * count));
+        unsigned index = ip;
+        int32_t caseKey = codeReadInt32(t, code, index);
+        for (unsigned i = 0; i < count; ++i) {
+          uint32_t newIp;
+          if (caseKey == static_cast<int32_t>(bottom + i)) {
+            newIp = base + codeReadInt32(t, code, index);
+            assertT(t, newIp < code->length());
+
+            if (index < ip + (pairCount * 8)) {
+              caseKey = codeReadInt32(t, code, index);
+            }
+          } else {
+            newIp = defaultIp;
+          }
+
+          ipTable[i] = newIp;
+
+          avian::codegen::Promise* p = c->poolAppendPromise(
+              frame->addressPromise(frame->machineIp(newIp)));
+          if (i == 0) {
+            start = p;
+          }
+        }
+        assertT(t, start);
+
+        c->condJump(lir::JumpIfLess,
+                    c->constant(bottom, ir::Type::i4()),
+                    key,
+                    frame->machineIpValue(defaultIp));
+
+        c->save(ir::Type::i4(), key);
+
+        new (stack.push(sizeof(SwitchState))) SwitchState(
+            c->saveState(), count, defaultIp, key, start, bottom, top);
+
+        stack.pushValue(Untable0);
+        ip = defaultIp;
+        goto start;
+      } else if (pairCount) {
         ir::Value* default_ = frame->addressOperand(
             frame->addressPromise(frame->machineIp(defaultIp)));
 
@@ -5930,22 +7611,12 @@ loop:
 
     case monitorenter: {
       ir::Value* target = frame->pop(ir::Type::object());
-      c->nativeCall(c->constant(getThunk(t, acquireMonitorForObjectThunk),
-                                ir::Type::iptr()),
-                    0,
-                    frame->trace(0, 0),
-                    ir::Type::void_(),
-                    args(c->threadRegister(), target));
+      compileMonitorAcquire(t, frame, target, acquireMonitorForObjectThunk);
     } break;
 
     case monitorexit: {
       ir::Value* target = frame->pop(ir::Type::object());
-      c->nativeCall(c->constant(getThunk(t, releaseMonitorForObjectThunk),
-                                ir::Type::iptr()),
-                    0,
-                    frame->trace(0, 0),
-                    ir::Type::void_(),
-                    args(c->threadRegister(), target));
+      compileMonitorRelease(t, frame, target, releaseMonitorForObjectThunk);
     } break;
 
     case multianewarray: {
@@ -6008,6 +7679,26 @@ loop:
           thunk = makeNewGeneral64Thunk;
         } else {
           thunk = makeNew64Thunk;
+
+          // the instance layout only matches the target if the word
+          // sizes do:
+          if (TargetBytesPerWord == BytesPerWord
+              and (class_->vmFlags() & NeedInitFlag) == 0
+              and pad(class_->fixedSize()) <= ThreadHeapSizeInBytes) {
+            frame->push(
+                ir::Type::object(),
+                compileAllocation(
+                    t,
+                    frame,
+                    c->constant(
+                        ceilingDivide(class_->fixedSize(), BytesPerWord),
+                        ir::Type::i4()),
+                    0,
+                    class_,
+                    thunk,
+                    args(c->threadRegister(), frame->append(class_))));
+            break;
+          }
         }
       } else {
         argument = makePair(t, context->method, reference);
@@ -6028,15 +7719,55 @@ loop:
 
       ir::Value* length = frame->pop(ir::Type::i4());
 
+      GcClass* class_;
+      unsigned elementSize;
+      switch (type) {
+      case T_BOOLEAN:
+        class_ = vm::type(t, GcBooleanArray::Type);
+        elementSize = 1;
+        break;
+      case T_CHAR:
+        class_ = vm::type(t, GcCharArray::Type);
+        elementSize = 2;
+        break;
+      case T_FLOAT:
+        class_ = vm::type(t, GcFloatArray::Type);
+        elementSize = 4;
+        break;
+      case T_DOUBLE:
+        class_ = vm::type(t, GcDoubleArray::Type);
+        elementSize = 8;
+        break;
+      case T_BYTE:
+        class_ = vm::type(t, GcByteArray::Type);
+        elementSize = 1;
+        break;
+      case T_SHORT:
+        class_ = vm::type(t, GcShortArray::Type);
+        elementSize = 2;
+        break;
+      case T_INT:
+        class_ = vm::type(t, GcIntArray::Type);
+        elementSize = 4;
+        break;
+      case T_LONG:
+        class_ = vm::type(t, GcLongArray::Type);
+        elementSize = 8;
+        break;
+      default:
+        abort(t);
+      }
+
       frame->push(ir::Type::object(),
-                  c->nativeCall(c->constant(getThunk(t, makeBlankArrayThunk),
-                                            ir::Type::iptr()),
-                                0,
-                                frame->trace(0, 0),
-                                ir::Type::object(),
-                                args(c->threadRegister(),
-                                     c->constant(type, ir::Type::i4()),
-                                     length)));
+                  compileArrayAllocation(t,
+                                         frame,
+                                         length,
+                                         elementSize,
+                                         class_,
+                                         makeBlankArrayThunk,
+                                         args(c->threadRegister(),
+                                              c->constant(type, ir::Type::i4()),
+                                              length)));
     } break;
 
     case nop:
@@ -6165,16 +7896,15 @@ loop:
 
         case ObjectField:
           if (instruction == putfield) {
-            c->nativeCall(
-                c->constant(getThunk(t, setMaybeNullThunk), ir::Type::iptr()),
-                0,
-                frame->trace(0, 0),
-                ir::Type::void_(),
-                args(c->threadRegister(),
-                     table,
-                     c->constant(targetFieldOffset(context, field),
-                                 ir::Type::i4()),
-                     value));
+            storeReference(
+                t,
+                frame,
+                table,
+                c->constant(targetFieldOffset(context, field), ir::Type::i4()),
+                c->memory(table,
+                          ir::Type::object(),
+                          targetFieldOffset(context, field)),
+                value);
           } else {
             c->nativeCall(
                 c->constant(getThunk(t, setObjectThunk), ir::Type::iptr()),
@@ -6525,6 +8255,47 @@ next:
   }
     goto switchloop;
 
+  case Unlookup: {
+    if (DebugInstructions) {
+      fprintf(stderr, "Unlookup\n");
+    }
+    unsigned index = stack.popValue() + 1;
+    unsigned base = stack.popValue();
+    ir::Value* key = reinterpret_cast<ir::Value*>(stack.popValue());
+    c->restoreState(reinterpret_cast<Compiler::State*>(stack.popValue()));
+    frame = static_cast<Frame*>(stack.peek(sizeof(Frame)));
+
+    unsigned pairs = ((base + 4) & ~3);
+    uint32_t defaultIp = base + codeReadInt32(t, code, pairs);
+    unsigned pairCount = codeReadInt32(t, code, pairs);
+
+    if (index < pairCount) {
+      pairs += index * 8;
+      int32_t caseKey = codeReadInt32(t, code, pairs);
+      uint32_t newIp = base + codeReadInt32(t, code, pairs);
+      assertT(t, newIp < code->length());
+
+      c->condJump(lir::JumpIfEqual,
+                  c->constant(caseKey, ir::Type::i4()),
+                  key,
+                  frame->machineIpValue(newIp));
+
+      c->save(ir::Type::i4(), key);
+
+      stack.pushValue(reinterpret_cast<uintptr_t>(c->saveState()));
+      stack.pushValue(reinterpret_cast<uintptr_t>(key));
+      stack.pushValue(base);
+      stack.pushValue(index);
+      stack.pushValue(Unlookup);
+      ip = newIp;
+      goto start;
+    } else {
+      c->jmp(frame->machineIpValue(defaultIp));
+      ip = defaultIp;
+    }
+  }
+    goto loop;
+
   case Unsubroutine: {
     if (DebugInstructions) {
       fprintf(stderr, "Unsubroutine\n");
@@ -7165,15 +8936,20 @@ void finish(MyThread* t, FixedAllocator* allocator, Context* context)
     trap();
   }
 
-  // todo: this is a CPU-intensive operation, so consider doing it
-  // earlier before we've acquired the global class lock to improve
-  // parallelism (the downside being that it may end up being a waste
-  // of cycles if another thread compiles the same method in parallel,
-  // which might be mitigated by fine-grained, per-method locking):
-  c->compile(context->leaf ? 0 : stackOverflowThunk(t),
-             TARGET_THREAD_STACKLIMIT);
+  // the caller must hold the class lock by now, since we're about to
+  // allocate executable memory and publish the result
 
-  // we must acquire the class lock here at the latest
+  if (context->bootContext == 0) {
+    // the machine code can't grow by more than its own length when
+    // resolved (e.g. due to alignment padding or constant pools), so
+    // this is a safe upper bound on what we'll allocate below:
+    ensureCodeCapacity(
+        t,
+        (context->assembler->length() * 2) + c->poolSize()
+            + context->assembler->footerSize()
+            + ((context->objectPoolCount + 1) * BytesPerWord)
+            + GcArray::FixedSize + (TargetBytesPerWord * 2));
+  }
 
   unsigned codeSize = c->resolve(allocator->memory.begin() + allocator->offset);
 
@@ -7226,85 +9002,593 @@ void finish(MyThread* t, FixedAllocator* allocator, Context* context)
       p->basis = new (bc->zone)
           avian::codegen::ResolvedPromise(p->basis->value());
     }
-  }
+  }
+
+  {
+    GcArray* newExceptionHandlerTable = translateExceptionHandlerTable(
+        t,
+        context,
+        reinterpret_cast<intptr_t>(start),
+        reinterpret_cast<intptr_t>(start) + codeSize);
+
+    PROTECT(t, newExceptionHandlerTable);
+
+    GcLineNumberTable* newLineNumberTable = translateLineNumberTable(
+        t, context, reinterpret_cast<intptr_t>(start));
+
+    GcCode* code = context->method->code();
+
+    code = makeCode(t,
+                    0,
+                    0,
+                    newExceptionHandlerTable,
+                    newLineNumberTable,
+                    reinterpret_cast<uintptr_t>(start),
+                    codeSize,
+                    code->maxStack(),
+                    code->maxLocals(),
+                    0);
+
+    context->method->setCode(t, code);
+  }
+
+  if (context->traceLogCount) {
+    THREAD_RUNTIME_ARRAY(t, TraceElement*, elements, context->traceLogCount);
+    unsigned index = 0;
+    // unsigned pathFootprint = 0;
+    // unsigned mapCount = 0;
+    for (TraceElement* p = context->traceLog; p; p = p->next) {
+      assertT(t, index < context->traceLogCount);
+
+      if (p->address) {
+        RUNTIME_ARRAY_BODY(elements)[index++] = p;
+
+        if (p->target) {
+          insertCallNode(
+              t, makeCallNode(t, p->address->value(), p->target, p->flags, 0));
+
+          if (p->flags & TraceElement::Devirtualized) {
+            // the target may have been overridden since we checked
+            // during the first pass:
+            if (p->target->vmFlags() & OverriddenFlag) {
+              updateCall(t,
+                         alignedCallOperation(p->flags),
+                         reinterpret_cast<void*>(p->address->value()),
+                         reinterpret_cast<void*>(
+                             dispatchStub(t, p->target->offset())));
+            } else {
+              p->target->vmFlags() |= DevirtualizedFlag;
+            }
+          }
+        }
+      }
+    }
+
+    qsort(RUNTIME_ARRAY_BODY(elements),
+          index,
+          sizeof(TraceElement*),
+          compareTraceElementPointers);
+
+    GcIntArray* map = makeSimpleFrameMapTable(
+        t, context, start, RUNTIME_ARRAY_BODY(elements), index);
+
+    context->method->code()->setStackMap(t, map);
+  }
+
+  logCompile(
+      t,
+      start,
+      codeSize,
+      reinterpret_cast<const char*>(
+          context->method->class_()->name()->body().begin()),
+      reinterpret_cast<const char*>(context->method->name()->body().begin()),
+      reinterpret_cast<const char*>(context->method->spec()->body().begin()));
+
+  // for debugging:
+  if (false
+      and ::strcmp(reinterpret_cast<const char*>(
+                       context->method->class_()->name()->body().begin()),
+                   "java/lang/System") == 0
+      and ::strcmp(reinterpret_cast<const char*>(
+                       context->method->name()->body().begin()),
+                   "<clinit>") == 0) {
+    trap();
+  }
+  syncInstructionCache(start, codeSize);
+}
+
+unsigned instructionLength(MyThread* t, GcCode* code, unsigned ip)
+{
+  unsigned instruction = code->body()[ip];
+  switch (instruction) {
+  case bipush:
+  case ldc:
+  case ret:
+  case newarray:
+    return 2;
+
+  case sipush:
+  case ldc_w:
+  case ldc2_w:
+  case iinc:
+  case ifnull:
+  case ifnonnull:
+  case new_:
+  case anewarray:
+  case checkcast:
+  case instanceof:
+    return 3;
+
+  case multianewarray:
+    return 4;
+
+  case invokeinterface:
+  case invokedynamic:
+  case goto_w:
+  case jsr_w:
+    return 5;
+
+  case wide:
+    return code->body()[ip + 1] == iinc ? 6 : 4;
+
+  case tableswitch: {
+    unsigned index = ((ip + 4) & ~3) + 4;
+    int32_t bottom = codeReadInt32(t, code, index);
+    int32_t top = codeReadInt32(t, code, index);
+    return index + ((top - bottom + 1) * 4) - ip;
+  }
+
+  case lookupswitch: {
+    unsigned index = ((ip + 4) & ~3) + 4;
+    int32_t pairCount = codeReadInt32(t, code, index);
+    return index + (pairCount * 8) - ip;
+  }
+
+  default:
+    if ((instruction >= iload and instruction <= aload)
+        or (instruction >= istore and instruction <= astore)) {
+      return 2;
+    } else if ((instruction >= ifeq and instruction <= jsr)
+               or (instruction >= getstatic and instruction <= invokestatic)) {
+      return 3;
+    } else {
+      return 1;
+    }
+  }
+}
+
+// If the instruction at ip loads a local variable using the specified
+// instruction (iload, lload, fload, dload, or aload) or its short
+// form, sets *index to that variable and returns true.
+bool loadsLocal(MyThread* t,
+                GcCode* code,
+                unsigned ip,
+                unsigned load,
+                unsigned* index)
+{
+  unsigned instruction = code->body()[ip];
+  unsigned short_ = iload_0 + ((load - iload) * 4);
+  if (instruction == load) {
+    *index = code->body()[ip + 1];
+    return true;
+  } else if (instruction == wide and code->body()[ip + 1] == load) {
+    ip += 2;
+    *index = static_cast<uint16_t>(codeReadInt16(t, code, ip));
+    return true;
+  } else if (instruction >= short_ and instruction < short_ + 4) {
+    *index = instruction - short_;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// Returns true if the instruction at ip may write to the specified
+// local variable.
+bool storesLocal(MyThread* t, GcCode* code, unsigned ip, unsigned local)
+{
+  unsigned instruction = code->body()[ip];
+  unsigned index;
+  unsigned size;
+  if (instruction >= istore and instruction <= astore) {
+    index = code->body()[ip + 1];
+  } else if (instruction >= istore_0 and instruction <= astore_3) {
+    index = (instruction - istore_0) % 4;
+    instruction = istore + ((instruction - istore_0) / 4);
+  } else if (instruction == iinc) {
+    index = code->body()[ip + 1];
+  } else if (instruction == wide) {
+    instruction = code->body()[ip + 1];
+    ip += 2;
+    index = static_cast<uint16_t>(codeReadInt16(t, code, ip));
+  } else {
+    return false;
+  }
+
+  if (instruction == lstore or instruction == dstore) {
+    size = 2;
+  } else if ((instruction >= istore and instruction <= astore)
+             or instruction == iinc) {
+    size = 1;
+  } else {
+    return false;
+  }
+
+  return local >= index and local < index + size;
+}
+
+// If the instruction at ip does nothing but push, pop, or operate on
+// operands (aside from possibly throwing an exception), sets *pops and
+// *pushes to the number of stack slots it consumes and produces and
+// returns true.
+bool simpleStackEffect(GcCode* code,
+                       unsigned ip,
+                       unsigned* pops,
+                       unsigned* pushes)
+{
+  // conversions from i2l through i2s, as (pops << 4) | pushes:
+  static const uint8_t conversions[] = {0x12, 0x11, 0x12, 0x21, 0x21,
+                                        0x22, 0x11, 0x12, 0x12, 0x21,
+                                        0x22, 0x21, 0x11, 0x11, 0x11};
+
+  unsigned instruction = code->body()[ip];
+  bool wideType = instruction == lconst_0 or instruction == lconst_1
+                      or instruction == dconst_0 or instruction == dconst_1
+                      or instruction == ldc2_w or instruction == lload
+                      or instruction == dload;
+
+  if ((instruction >= aconst_null and instruction <= aload)
+      or instruction == ldc2_w) {
+    *pops = 0;
+    *pushes = wideType ? 2 : 1;
+  } else if (instruction >= iload_0 and instruction <= aload_3) {
+    unsigned type = (instruction - iload_0) / 4;
+    *pops = 0;
+    *pushes = (type == 1 or type == 3) ? 2 : 1;
+  } else if (instruction >= iaload and instruction <= saload) {
+    *pops = 2;
+    *pushes = (instruction == laload or instruction == daload) ? 2 : 1;
+  } else if (instruction >= iadd and instruction <= vm::drem) {
+    wideType = ((instruction - iadd) % 2) == 1;
+    *pops = wideType ? 4 : 2;
+    *pushes = wideType ? 2 : 1;
+  } else if (instruction >= ineg and instruction <= dneg) {
+    *pops = *pushes = ((instruction - ineg) % 2) == 1 ? 2 : 1;
+  } else if (instruction >= ishl and instruction <= lushr) {
+    wideType = ((instruction - ishl) % 2) == 1;
+    *pops = wideType ? 3 : 2;
+    *pushes = wideType ? 2 : 1;
+  } else if (instruction >= iand and instruction <= lxor) {
+    wideType = ((instruction - iand) % 2) == 1;
+    *pops = wideType ? 4 : 2;
+    *pushes = wideType ? 2 : 1;
+  } else if (instruction >= i2l and instruction <= i2s) {
+    *pops = conversions[instruction - i2l] >> 4;
+    *pushes = conversions[instruction - i2l] & 0xF;
+  } else if (instruction == arraylength) {
+    *pops = *pushes = 1;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Marks array accesses in the loop body [bodyStart, bodyEnd) whose
+// array and index operands come straight from the specified locals.
+// The caller has established that index is in range for array
+// everywhere in the body.
+void markUncheckedArrayAccesses(MyThread* t,
+                                GcCode* code,
+                                Slice<uint32_t> firstSource,
+                                Slice<bool> unchecked,
+                                unsigned bodyStart,
+                                unsigned bodyEnd,
+                                unsigned array,
+                                unsigned index)
+{
+  for (unsigned ip = bodyStart; ip < bodyEnd;
+       ip += instructionLength(t, code, ip)) {
+    unsigned local;
+    if (not(loadsLocal(t, code, ip, aload, &local) and local == array)) {
+      continue;
+    }
+
+    unsigned indexIp = ip + instructionLength(t, code, ip);
+    if (not(indexIp < bodyEnd and loadsLocal(t, code, indexIp, iload, &local)
+            and local == index and firstSource[indexIp] == ~0u)) {
+      continue;
+    }
+
+    // walk forward while the array and index are provably the two
+    // operands beneath the top of the stack:
+    unsigned depth = 0;
+    for (unsigned p = indexIp + instructionLength(t, code, indexIp);
+         p < bodyEnd and firstSource[p] == ~0u;
+         p += instructionLength(t, code, p)) {
+      unsigned instruction = code->body()[p];
+      if (depth == 0 and instruction >= iaload and instruction <= saload) {
+        unchecked[p] = true;
+        break;
+      } else if (instruction >= iastore and instruction <= sastore) {
+        if (depth == ((instruction == lastore or instruction == dastore)
+                          ? 2u
+                          : 1u)) {
+          unchecked[p] = true;
+        }
+        break;
+      }
+
+      unsigned pops;
+      unsigned pushes;
+      if (not simpleStackEffect(code, p, &pops, &pushes) or pops > depth) {
+        break;
+      }
+      depth += pushes - pops;
+    }
+  }
+}
+
+// Records, for each ip in the current method, the lowest and highest
+// ips of the instructions which may branch to it, leaving ~0u and 0
+// for those which are reached only by falling through.  Exception
+// handlers are treated as reachable from anywhere.  Returns false
+// without recording anything if the method uses subroutines, which
+// are duplicated during compilation and so aren't worth analyzing.
+bool findBranchSources(MyThread* t,
+                       Context* context,
+                       Slice<uint32_t>* firstSource,
+                       Slice<uint32_t>* lastSource)
+{
+  GcCode* code = context->method->code();
+  unsigned length = code->length();
+  Slice<uint32_t> first
+      = Slice<uint32_t>::allocAndSet(&context->zone, length, ~0u);
+  Slice<uint32_t> last
+      = Slice<uint32_t>::allocAndSet(&context->zone, length, 0);
+
+  for (unsigned ip = 0; ip < length; ip += instructionLength(t, code, ip)) {
+    unsigned instruction = code->body()[ip];
+    unsigned index = ip + 1;
+    unsigned targetCount = 0;
+    int32_t targets[2];
+    switch (instruction) {
+    case jsr:
+    case jsr_w:
+    case ret:
+      return false;
+
+    case goto_w:
+      targets[targetCount++] = ip + codeReadInt32(t, code, index);
+      break;
+
+    case tableswitch:
+    case lookupswitch: {
+      index = (ip + 4) & ~3;
+      unsigned count;
+      unsigned stride;
+      targets[targetCount++] = ip + codeReadInt32(t, code, index);
+      if (instruction == tableswitch) {
+        int32_t bottom = codeReadInt32(t, code, index);
+        int32_t top = codeReadInt32(t, code, index);
+        count = top - bottom + 1;
+        stride = 4;
+      } else {
+        count = codeReadInt32(t, code, index);
+        stride = 8;
+        index += 4;
+      }
+
+      for (unsigned i = 0; i < count; ++i) {
+        unsigned p = index + (i * stride);
+        uint32_t target = ip + codeReadInt32(t, code, p);
+        first[target] = min(first[target], ip);
+        last[target] = max(last[target], ip);
+      }
+    } break;
+
+    default:
+      if ((instruction >= ifeq and instruction <= goto_)
+          or instruction == ifnull or instruction == ifnonnull) {
+        targets[targetCount++] = ip + codeReadInt16(t, code, index);
+      }
+      break;
+    }
 
-  {
-    GcArray* newExceptionHandlerTable = translateExceptionHandlerTable(
-        t,
-        context,
-        reinterpret_cast<intptr_t>(start),
-        reinterpret_cast<intptr_t>(start) + codeSize);
+    for (unsigned i = 0; i < targetCount; ++i) {
+      first[targets[i]] = min(first[targets[i]], ip);
+      last[targets[i]] = max(last[targets[i]], ip);
+    }
+  }
 
-    PROTECT(t, newExceptionHandlerTable);
+  GcExceptionHandlerTable* eht
+      = cast<GcExceptionHandlerTable>(t, code->exceptionHandlerTable());
+  if (eht) {
+    for (unsigned i = 0; i < eht->length(); ++i) {
+      unsigned handler = exceptionHandlerIp(eht->body()[i]);
+      first[handler] = 0;
+      last[handler] = length;
+    }
+  }
 
-    GcLineNumberTable* newLineNumberTable = translateLineNumberTable(
-        t, context, reinterpret_cast<intptr_t>(start));
+  *firstSource = first;
+  *lastSource = last;
+  return true;
+}
 
-    GcCode* code = context->method->code();
+// Looks for counted loops of the form javac generates for
+//
+//   for (int i = c; i < a.length; ++i) { ... }
+//
+// where c is a non-negative constant and a is a local variable, i.e.:
+//
+//   push c; istore i;
+//   H: iload i; aload a; arraylength; if_icmpge X;
+//   ... body ...
+//   iinc i 1; goto H;
+//   X:
+//
+// If the body never writes to i or a, and no control flow enters the
+// loop except through its initializer, then i is known to be in
+// range for a throughout the body, and the bounds checks on a[i] may
+// be omitted.  Returns a table indexed by ip marking the xaload and
+// xastore instructions for which this is the case.
+Slice<bool> findUncheckedArrayAccesses(MyThread* t, Context* context)
+{
+  GcCode* code = context->method->code();
+  unsigned length = code->length();
+  Slice<bool> unchecked = Slice<bool>::allocAndSet(&context->zone, length, 0);
+
+  Slice<uint32_t> firstSource(0, 0);
+  Slice<uint32_t> lastSource(0, 0);
+  if (not findBranchSources(t, context, &firstSource, &lastSource)) {
+    return unchecked;
+  }
+
+  unsigned previous = length;
+  unsigned beforePrevious = length;
+  for (unsigned ip = 0; ip < length;
+       beforePrevious = previous, previous = ip,
+                ip += instructionLength(t, code, ip)) {
+    unsigned loop = ip;
+    unsigned index;
+    unsigned array;
+    if (beforePrevious == length
+        or not loadsLocal(t, code, loop, iload, &index)) {
+      continue;
+    }
+
+    unsigned p = loop + instructionLength(t, code, loop);
+    if (not(loadsLocal(t, code, p, aload, &array) and array != index)) {
+      continue;
+    }
+
+    p += instructionLength(t, code, p);
+    if (code->body()[p] != arraylength or code->body()[p + 1] != if_icmpge) {
+      continue;
+    }
+
+    unsigned branch = p + 1;
+    p = branch + 1;
+    unsigned exit = branch + codeReadInt16(t, code, p);
+    unsigned bodyStart = p;
+    unsigned increment = exit - 6;
+    if (exit <= branch or exit > length or increment < bodyStart) {
+      continue;
+    }
+
+    // check for "push c; istore i" just before the loop:
+    unsigned constant = code->body()[beforePrevious];
+    int value;
+    if (constant >= iconst_0 and constant <= iconst_5) {
+      value = constant - iconst_0;
+    } else if (constant == bipush) {
+      value = static_cast<int8_t>(code->body()[beforePrevious + 1]);
+    } else if (constant == sipush) {
+      p = beforePrevious + 1;
+      value = codeReadInt16(t, code, p);
+    } else {
+      continue;
+    }
 
-    code = makeCode(t,
-                    0,
-                    0,
-                    newExceptionHandlerTable,
-                    newLineNumberTable,
-                    reinterpret_cast<uintptr_t>(start),
-                    codeSize,
-                    code->maxStack(),
-                    code->maxLocals(),
-                    0);
+    unsigned store = code->body()[previous];
+    if (value < 0
+        or not((store == istore and code->body()[previous + 1] == index)
+               or (index < 4 and store == istore_0 + index))) {
+      continue;
+    }
 
-    context->method->setCode(t, code);
-  }
+    // check for "iinc i 1; goto H" at the end of the loop:
+    p = increment + 4;
+    if (code->body()[increment] != iinc
+        or code->body()[increment + 1] != index
+        or code->body()[increment + 2] != 1
+        or code->body()[increment + 3] != goto_
+        or increment + 3 + codeReadInt16(t, code, p) != loop) {
+      continue;
+    }
 
-  if (context->traceLogCount) {
-    THREAD_RUNTIME_ARRAY(t, TraceElement*, elements, context->traceLogCount);
-    unsigned index = 0;
-    // unsigned pathFootprint = 0;
-    // unsigned mapCount = 0;
-    for (TraceElement* p = context->traceLog; p; p = p->next) {
-      assertT(t, index < context->traceLogCount);
+    // check that the body writes to neither local and that the iinc
+    // is on an instruction boundary:
+    p = bodyStart;
+    while (p < increment and not storesLocal(t, code, p, index)
+           and not storesLocal(t, code, p, array)) {
+      p += instructionLength(t, code, p);
+    }
 
-      if (p->address) {
-        RUNTIME_ARRAY_BODY(elements)[index++] = p;
+    if (p != increment) {
+      continue;
+    }
 
-        if (p->target) {
-          insertCallNode(
-              t, makeCallNode(t, p->address->value(), p->target, p->flags, 0));
+    // check that the loop is entered only from its initializer, that
+    // its header is entered only from its back edge, and that the
+    // body is entered only from the header or the body itself:
+    bool entered = false;
+    for (p = previous; p <= increment + 3 and not entered; ++p) {
+      if (firstSource[p] != ~0u) {
+        if (p == loop) {
+          entered = firstSource[p] != increment + 3
+                    or lastSource[p] != increment + 3;
+        } else if (p >= bodyStart and p <= increment) {
+          entered = firstSource[p] < bodyStart or lastSource[p] > increment;
+        } else {
+          entered = true;
         }
       }
     }
 
-    qsort(RUNTIME_ARRAY_BODY(elements),
-          index,
-          sizeof(TraceElement*),
-          compareTraceElementPointers);
+    if (not entered) {
+      markUncheckedArrayAccesses(t,
+                                 code,
+                                 firstSource,
+                                 unchecked,
+                                 bodyStart,
+                                 increment,
+                                 array,
+                                 index);
+    }
+  }
 
-    GcIntArray* map = makeSimpleFrameMapTable(
-        t, context, start, RUNTIME_ARRAY_BODY(elements), index);
+  return unchecked;
+}
 
-    context->method->code()->setStackMap(t, map);
+// Returns a table indexed by ip marking the invokevirtual
+// instructions whose receiver is provably "this", i.e. those which
+// immediately follow an aload_0 in an instance method that never
+// writes to local 0, and which no branch or exception handler
+// targets.  Devirtualized calls through such instructions need no
+// explicit null check.
+Slice<bool> findSelfCalls(MyThread* t, Context* context)
+{
+  GcCode* code = context->method->code();
+  unsigned length = code->length();
+  Slice<bool> selfCalls = Slice<bool>::allocAndSet(&context->zone, length, 0);
+
+  if (context->method->flags() & ACC_STATIC) {
+    return selfCalls;
   }
 
-  logCompile(
-      t,
-      start,
-      codeSize,
-      reinterpret_cast<const char*>(
-          context->method->class_()->name()->body().begin()),
-      reinterpret_cast<const char*>(context->method->name()->body().begin()),
-      reinterpret_cast<const char*>(context->method->spec()->body().begin()));
+  Slice<uint32_t> firstSource(0, 0);
+  Slice<uint32_t> lastSource(0, 0);
+  if (not findBranchSources(t, context, &firstSource, &lastSource)) {
+    return selfCalls;
+  }
 
-  // for debugging:
-  if (false
-      and ::strcmp(reinterpret_cast<const char*>(
-                       context->method->class_()->name()->body().begin()),
-                   "java/lang/System") == 0
-      and ::strcmp(reinterpret_cast<const char*>(
-                       context->method->name()->body().begin()),
-                   "<clinit>") == 0) {
-    trap();
+  for (unsigned ip = 0; ip < length; ip += instructionLength(t, code, ip)) {
+    if (storesLocal(t, code, ip, 0)) {
+      return selfCalls;
+    }
   }
-  syncInstructionCache(start, codeSize);
+
+  unsigned previous = length;
+  for (unsigned ip = 0; ip < length;
+       previous = ip, ip += instructionLength(t, code, ip)) {
+    if (code->body()[ip] == invokevirtual and previous != length
+        and code->body()[previous] == aload_0 and firstSource[ip] == ~0u) {
+      selfCalls[ip] = true;
+    }
+  }
+
+  return selfCalls;
 }
 
 void compile(MyThread* t, Context* context)
@@ -7373,6 +9657,14 @@ void compile(MyThread* t, Context* context)
 
   handleEntrance(t, &frame);
 
+  if (CheckArrayBounds) {
+    context->uncheckedArrayAccesses = findUncheckedArrayAccesses(t, context);
+  }
+
+  if (context->bootContext == 0) {
+    context->selfCalls = findSelfCalls(t, context);
+  }
+
   Compiler::State* state = c->saveState();
 
   compile(t, &frame, 0);
@@ -8681,6 +10973,8 @@ bool isThunk(MyThread* t, void* ip);
 
 bool isVirtualThunk(MyThread* t, void* ip);
 
+bool isDispatchStub(MyThread* t, void* ip);
+
 bool isThunkUnsafeStack(MyThread* t, void* ip);
 
 void boot(MyThread* t, BootImage* image, uint8_t* code);
@@ -8689,6 +10983,8 @@ class MyProcessor;
 
 MyProcessor* processor(MyThread* t);
 
+void logCodeArea(MyProcessor* p);
+
 #ifndef AVIAN_AOT_ONLY
 void compileThunks(MyThread* t, FixedAllocator* allocator);
 #endif
@@ -8731,6 +11027,20 @@ int checkConstant(MyThread* t, size_t expected, T C::*field, const char* name)
   return 0;
 }
 
+// a region of executable memory which has filled up and been
+// replaced by another (see ensureCodeCapacity)
+class CodeArea {
+ public:
+  CodeArea(Slice<uint8_t> memory, size_t used, CodeArea* next)
+      : memory(memory), used(used), next(next)
+  {
+  }
+
+  Slice<uint8_t> memory;
+  size_t used;
+  CodeArea* next;
+};
+
 class MyProcessor : public Processor {
  public:
   class Thunk {
@@ -8778,6 +11088,7 @@ class MyProcessor : public Processor {
                             &GcRoots::arithmeticException,
                             GcArithmeticException::FixedSize),
         codeAllocator(s, Slice<uint8_t>(0, 0)),
+        retiredCodeAreas(0),
         callTableSize(0),
         dynamicIndex(0),
         useNativeFeatures(useNativeFeatures),
@@ -8878,7 +11189,27 @@ class MyProcessor : public Processor {
           + checkConstant(t,
                           TARGET_THREAD_STACKLIMIT,
                           &MyThread::stackLimit,
-                          "TARGET_THREAD_STACKLIMIT");
+                          "TARGET_THREAD_STACKLIMIT")
+          + checkConstant(t,
+                          TARGET_THREAD_HEAPINDEX,
+                          &Thread::heapIndex,
+                          "TARGET_THREAD_HEAPINDEX")
+          + checkConstant(t,
+                          TARGET_THREAD_HEAP,
+                          &Thread::heap,
+                          "TARGET_THREAD_HEAP")
+          + checkConstant(t,
+                          TARGET_THREAD_FLAGS,
+                          &Thread::flags,
+                          "TARGET_THREAD_FLAGS")
+          + checkConstant(t,
+                          TARGET_THREAD_CARDTABLE,
+                          &MyThread::cardTable,
+                          "TARGET_THREAD_CARDTABLE")
+          + checkConstant(t,
+                          TARGET_THREAD_THINLOCKTABLE,
+                          &MyThread::thinLockTable,
+                          "TARGET_THREAD_THINLOCKTABLE");
 
     if (mismatches > 0) {
       fprintf(stderr, "%d constant mismatches\n", mismatches);
@@ -8982,6 +11313,23 @@ class MyProcessor : public Processor {
     }
   }
 
+  virtual void methodOverridden(Thread* vmt, GcMethod* method)
+  {
+    MyThread* t = static_cast<MyThread*>(vmt);
+
+    PROTECT(t, method);
+
+    ACQUIRE(t, t->m->classLock);
+
+    if ((method->vmFlags() & OverriddenFlag) == 0) {
+      method->vmFlags() |= OverriddenFlag;
+
+      if (method->vmFlags() & DevirtualizedFlag) {
+        local::invalidateDevirtualizedCalls(t, method);
+      }
+    }
+  }
+
   virtual void visitObjects(Thread* vmt, Heap::Visitor* v)
   {
     MyThread* t = static_cast<MyThread*>(vmt);
@@ -9245,12 +11593,21 @@ class MyProcessor : public Processor {
 
   virtual void dispose()
   {
+    logCodeArea(this);
+
     if (codeAllocator.memory.begin()) {
 #ifndef AVIAN_AOT_ONLY
       Memory::free(codeAllocator.memory);
 #endif
     }
 
+    for (CodeArea* a = retiredCodeAreas; a;) {
+      CodeArea* next = a->next;
+      Memory::free(a->memory);
+      allocator->free(a, sizeof(CodeArea));
+      a = next;
+    }
+
     if(compilationHandlers) {
       compilationHandlers->dispose(allocator);
     }
@@ -9303,15 +11660,18 @@ class MyProcessor : public Processor {
           c.ip = 0;
           c.stack = 0;
         } else if (target->stack and (not isThunkUnsafeStack(t, ip))
-                   and (not isVirtualThunk(t, ip))) {
+                   and (not isVirtualThunk(t, ip))
+                   and (not isDispatchStub(t, ip))) {
           // we caught the thread in a thunk or native code, and the
           // saved stack pointer indicates the most recent Java frame
           // on the stack
           c.ip = getIp(target);
           c.stack = target->stack;
-        } else if (isThunk(t, ip) or isVirtualThunk(t, ip)) {
-          // we caught the thread in a thunk where the stack register
-          // indicates the most recent Java frame on the stack
+        } else if (isThunk(t, ip) or isVirtualThunk(t, ip)
+                   or isDispatchStub(t, ip)) {
+          // we caught the thread in a thunk or dispatch stub where the
+          // stack register indicates the most recent Java frame on the
+          // stack
 
           // On e.g. x86, the return address will have already been
           // pushed onto the stack, in which case we use getIp to
@@ -9445,7 +11805,7 @@ class MyProcessor : public Processor {
     if (image and code) {
       local::boot(static_cast<MyThread*>(t), image, code);
     } else {
-      roots = makeCompileRoots(t, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+      roots = makeCompileRoots(t, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 
       {
         GcArray* ct = makeArray(t, 128);
@@ -9545,6 +11905,7 @@ class MyProcessor : public Processor {
   SignalHandler segFaultHandler;
   SignalHandler divideByZeroHandler;
   FixedAllocator codeAllocator;
+  CodeArea* retiredCodeAreas;
   ThunkCollection thunks;
   ThunkCollection bootThunks;
   unsigned callTableSize;
@@ -9662,20 +12023,22 @@ void* compileMethod2(MyThread* t, void* ip)
   }
 
   if (updateCaller) {
-    avian::codegen::lir::UnaryOperation op;
-    if (node->flags() & TraceElement::LongCall) {
-      if (node->flags() & TraceElement::TailCall) {
-        op = avian::codegen::lir::AlignedLongJump;
-      } else {
-        op = avian::codegen::lir::AlignedLongCall;
+    if (node->flags() & TraceElement::Devirtualized) {
+      // don't undo methodOverridden's patch if it got here first:
+      ACQUIRE(t, t->m->classLock);
+
+      if ((target->vmFlags() & OverriddenFlag) == 0) {
+        updateCall(t,
+                   alignedCallOperation(node->flags()),
+                   updateIp,
+                   reinterpret_cast<void*>(address));
       }
-    } else if (node->flags() & TraceElement::TailCall) {
-      op = avian::codegen::lir::AlignedJump;
     } else {
-      op = avian::codegen::lir::AlignedCall;
+      updateCall(t,
+                 alignedCallOperation(node->flags()),
+                 updateIp,
+                 reinterpret_cast<void*>(address));
     }
-
-    updateCall(t, op, updateIp, reinterpret_cast<void*>(address));
   }
 
   return reinterpret_cast<void*>(address);
@@ -9753,6 +12116,26 @@ bool isVirtualThunk(MyThread* t, void* ip)
   return false;
 }
 
+bool isDispatchStub(MyThread* t, void* ip)
+{
+  GcWordArray* a = compileRoots(t)->dispatchStubs();
+  if (a == 0) {
+    return false;
+  }
+
+  for (unsigned i = 0; i < a->length(); i += 2) {
+    uintptr_t start = a->body()[i];
+    uintptr_t end = start + a->body()[i + 1];
+
+    if (reinterpret_cast<uintptr_t>(ip) >= start
+        and reinterpret_cast<uintptr_t>(ip) < end) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 bool isThunkUnsafeStack(MyThread* t, void* ip)
 {
   MyProcessor* p = processor(t);
@@ -10572,6 +12955,10 @@ uintptr_t compileVirtualThunk(MyThread* t,
 
   *size = a->endBlock(false)->resolve(0, 0);
 
+#ifndef AVIAN_AOT_ONLY
+  ensureCodeCapacity(t, *size);
+#endif
+
   uint8_t* start = static_cast<uint8_t*>(
       codeAllocator(t)->allocate(*size, TargetBytesPerWord));
 
@@ -10622,6 +13009,128 @@ uintptr_t virtualThunk(MyThread* t, unsigned index)
   return oldArray->body()[index * 2];
 }
 
+uintptr_t compileDispatchStub(MyThread* t, unsigned index, unsigned* size)
+{
+  Context context(t);
+  avian::codegen::Assembler* a = context.assembler;
+
+  // load the receiver's class from the object header, exactly as
+  // compiled code does for an invokevirtual, using the same register
+  // the default virtual thunk uses for the receiver:
+  lir::RegisterPair class_(t->arch->virtualCallTarget());
+  lir::Memory instance(
+      t->arch->stack(),
+      (t->arch->frameFooterSize() + t->arch->frameReturnAddressSize())
+      * TargetBytesPerWord);
+
+  a->apply(
+      lir::Move,
+      OperandInfo(TargetBytesPerWord, lir::Operand::Type::Memory, &instance),
+      OperandInfo(
+          TargetBytesPerWord, lir::Operand::Type::RegisterPair, &class_));
+
+  lir::Memory header(class_.low, 0);
+
+  a->apply(
+      lir::Move,
+      OperandInfo(TargetBytesPerWord, lir::Operand::Type::Memory, &header),
+      OperandInfo(
+          TargetBytesPerWord, lir::Operand::Type::RegisterPair, &class_));
+
+  avian::codegen::ResolvedPromise maskPromise(TargetPointerMask);
+  lir::Constant mask(&maskPromise);
+
+  a->apply(
+      lir::And,
+      OperandInfo(TargetBytesPerWord, lir::Operand::Type::Constant, &mask),
+      OperandInfo(
+          TargetBytesPerWord, lir::Operand::Type::RegisterPair, &class_),
+      OperandInfo(
+          TargetBytesPerWord, lir::Operand::Type::RegisterPair, &class_));
+
+  lir::Memory entry(class_.low,
+                    TargetClassVtable + (index * TargetBytesPerWord));
+
+  a->apply(
+      lir::Move,
+      OperandInfo(TargetBytesPerWord, lir::Operand::Type::Memory, &entry),
+      OperandInfo(
+          TargetBytesPerWord, lir::Operand::Type::RegisterPair, &class_));
+
+  a->apply(lir::Jump,
+           OperandInfo(
+               TargetBytesPerWord, lir::Operand::Type::RegisterPair, &class_));
+
+  *size = a->endBlock(false)->resolve(0, 0);
+
+#ifndef AVIAN_AOT_ONLY
+  ensureCodeCapacity(t, *size);
+#endif
+
+  uint8_t* start = static_cast<uint8_t*>(
+      codeAllocator(t)->allocate(*size, TargetBytesPerWord));
+
+  a->setDestination(start);
+  a->write();
+
+  logCompile(t, start, *size, 0, "dispatchStub", 0);
+
+  return reinterpret_cast<uintptr_t>(start);
+}
+
+// returns a stub which dispatches a call through the receiver's
+// vtable entry at the specified index, for use at a call site which
+// can no longer be statically bound
+uintptr_t dispatchStub(MyThread* t, unsigned index)
+{
+  ACQUIRE(t, t->m->classLock);
+
+  GcWordArray* oldArray = compileRoots(t)->dispatchStubs();
+  if (oldArray == 0 or oldArray->length() <= index * 2) {
+    GcWordArray* newArray = makeWordArray(t, nextPowerOfTwo((index + 1) * 2));
+    if (compileRoots(t)->dispatchStubs()) {
+      memcpy(newArray->body().begin(),
+             oldArray->body().begin(),
+             oldArray->length() * BytesPerWord);
+    }
+    compileRoots(t)->setDispatchStubs(t, newArray);
+    oldArray = newArray;
+  }
+
+  if (oldArray->body()[index * 2] == 0) {
+    unsigned size;
+    uintptr_t stub = compileDispatchStub(t, index, &size);
+    oldArray->body()[index * 2] = stub;
+    oldArray->body()[(index * 2) + 1] = size;
+  }
+
+  return oldArray->body()[index * 2];
+}
+
+// called with classLock held when method is overridden for the first
+// time; patches each call site compiled as a direct call to method so
+// that it dispatches through the vtable instead
+void invalidateDevirtualizedCalls(MyThread* t, GcMethod* method)
+{
+  PROTECT(t, method);
+
+  void* stub = reinterpret_cast<void*>(dispatchStub(t, method->offset()));
+
+  GcArray* table = compileRoots(t)->callTable();
+  for (unsigned i = 0; i < table->length(); ++i) {
+    for (GcCallNode* p = cast<GcCallNode>(t, table->body()[i]); p;
+         p = p->next()) {
+      if ((p->flags() & TraceElement::Devirtualized)
+          and p->target() == method) {
+        updateCall(t,
+                   alignedCallOperation(p->flags()),
+                   reinterpret_cast<void*>(p->address()),
+                   stub);
+      }
+    }
+  }
+}
+
 void compile(MyThread* t,
              FixedAllocator* allocator UNUSED,
              BootContext* bootContext,
@@ -10663,6 +13172,15 @@ void compile(MyThread* t,
   Context context(t, bootContext, clone);
   compile(t, &context);
 
+  // Register allocation and code generation are CPU-intensive, so we
+  // do them here, before acquiring the global class lock, so that
+  // threads compiling different methods may proceed in parallel.  Only
+  // placing the code in executable memory and publishing it (see
+  // finish) is serialized.  If another thread finishes compiling the
+  // same method first, our work is simply discarded below.
+  context.compiler->compile(context.leaf ? 0 : stackOverflowThunk(t),
+                            TARGET_THREAD_STACKLIMIT);
+
   {
     GcExceptionHandlerTable* ehTable = cast<GcExceptionHandlerTable>(
         t, clone->code()->exceptionHandlerTable());
@@ -10748,6 +13266,127 @@ avian::util::FixedAllocator* codeAllocator(MyThread* t)
   return &(processor(t)->codeAllocator);
 }
 
+// Computes the smallest range of addresses covering all the
+// executable memory we've allocated for compiled code and thunks.
+void codeAreaBounds(MyThread* t, uintptr_t* start, uintptr_t* end)
+{
+  MyProcessor* p = processor(t);
+
+  *start = reinterpret_cast<uintptr_t>(p->codeAllocator.memory.begin());
+  *end = *start + p->codeAllocator.memory.count;
+
+  for (CodeArea* a = p->retiredCodeAreas; a; a = a->next) {
+    uintptr_t areaStart = reinterpret_cast<uintptr_t>(a->memory.begin());
+    *start = min(*start, areaStart);
+    *end = max(*end, areaStart + a->memory.count);
+  }
+}
+
+// records code area growth in the compile log, if any (see
+// logCompile).  Lines begin with '#' so they are distinct from the
+// address ranges of compiled methods.
+void logCodeArea(MyProcessor* p)
+{
+  if (compileLog == 0) {
+    return;
+  }
+
+  size_t used = p->codeAllocator.offset;
+  size_t capacity = p->codeAllocator.memory.count;
+  unsigned count = 1;
+  for (CodeArea* a = p->retiredCodeAreas; a; a = a->next) {
+    used += a->used;
+    capacity += a->memory.count;
+    ++count;
+  }
+
+  fprintf(compileLog,
+          "# code area: %u region(s), %u of %u bytes used (%u%%)\n",
+          count,
+          static_cast<unsigned>(used),
+          static_cast<unsigned>(capacity),
+          capacity ? static_cast<unsigned>((used * 100) / capacity) : 0);
+}
+
+#ifndef AVIAN_AOT_ONLY
+// Ensures that the code allocator can satisfy a request for the
+// specified number of bytes, retiring the current region of
+// executable memory in favor of a new one if necessary.  The caller
+// must hold the class lock.
+//
+// Compiled code uses immediate calls and jumps to reach thunks and
+// other compiled code, and decides whether it can do so for code in
+// the boot image based on the bounds of the code area (see
+// useLongJump).  Since such decisions may be made before we get here,
+// a new region is only accepted if every region is still within
+// immediate reach of every other and boot image code which was
+// reachable from the old bounds is still reachable from the new ones.
+// Otherwise, we keep the current region and let the allocation fail
+// as it always has.
+void ensureCodeCapacity(MyThread* t, size_t size)
+{
+  MyProcessor* p = processor(t);
+  FixedAllocator* a = &(p->codeAllocator);
+
+  if (p->bootImage
+      or a->offset + pad(size, TargetBytesPerWord) < a->memory.count) {
+    return;
+  }
+
+  Slice<uint8_t> memory
+      = Memory::allocate(max(static_cast<size_t>(ExecutableAreaSizeInBytes),
+                             pad(size + 1, Memory::PageSize)),
+                         Memory::ReadWriteExecute);
+
+  if (memory.begin() == 0) {
+    return;
+  }
+
+  uintptr_t reach = t->arch->maximumImmediateJump();
+
+  uintptr_t start;
+  uintptr_t end;
+  codeAreaBounds(t, &start, &end);
+
+  uintptr_t newStart = min(start, reinterpret_cast<uintptr_t>(memory.begin()));
+  uintptr_t newEnd
+      = max(end, reinterpret_cast<uintptr_t>(memory.begin()) + memory.count);
+
+  bool acceptable = newEnd - newStart < reach;
+
+  if (acceptable and p->codeImage) {
+    // the part of the boot image reachable from anywhere within the
+    // old bounds must also be reachable from anywhere within the new
+    // ones:
+    uintptr_t imageStart = reinterpret_cast<uintptr_t>(p->codeImage);
+    uintptr_t imageEnd = imageStart + p->codeImageSize;
+
+    uintptr_t low = max(imageStart, end > reach ? end - reach : 0);
+    uintptr_t high = min(
+        imageEnd, start < UINTPTR_MAX - reach ? start + reach : UINTPTR_MAX);
+
+    uintptr_t newLow = newEnd > reach ? newEnd - reach : 0;
+    uintptr_t newHigh
+        = newStart < UINTPTR_MAX - reach ? newStart + reach : UINTPTR_MAX;
+
+    acceptable = low >= high or (newLow <= low and high <= newHigh);
+  }
+
+  if (not acceptable) {
+    Memory::free(memory);
+    return;
+  }
+
+  p->retiredCodeAreas = new (p->allocator->allocate(sizeof(CodeArea)))
+      CodeArea(a->memory, a->offset, p->retiredCodeAreas);
+
+  a->memory = memory;
+  a->offset = 0;
+
+  logCodeArea(p);
+}
+#endif  // not AVIAN_AOT_ONLY
+
 Allocator* allocator(MyThread* t)
 {
   return processor(t)->allocator;
@@ -27,6 +27,23 @@ const unsigned Top = ~static_cast<unsigned>(0);
 const unsigned InitialGen2CapacityInBytes = 4 * 1024 * 1024;
 const unsigned InitialTenuredFixieCeilingInBytes = 4 * 1024 * 1024;
 
+// segment capacities, positions and bitmap indexes are 32-bit word
+// counts, so we cap each segment such that its footprint, including
+// the bitmaps (which add less than one word per 63), stays
+// representable.  On 64-bit systems this allows segments of nearly
+// 32GB.
+const unsigned MaxSegmentCapacityInWords = (0xFFFFFFFF / 64) * 63;
+
+const unsigned CopyBufferSizeInWords = 4 * 1024;
+const unsigned RootChunkSize = 64;
+const unsigned InitialWorkQueueCapacity = 1024;
+
+const unsigned CardSizeInWords = (1 << LogCardSizeInBytes) / BytesPerWord;
+
+const unsigned FreeListCount = 32;
+const unsigned MinimumFreeChunkSizeInWords = 2;
+const unsigned InitialMarkStackCapacity = 256;
+
 const bool Verbose = false;
 const bool Verbose2 = false;
 const bool Debug = false;
@@ -74,6 +91,30 @@ inline void markBitAtomic(uintptr_t* map, unsigned i)
        old = *p) {
   }
 }
+
+inline void setBitsAtomic(uintptr_t* map,
+                          unsigned bitsPerRecord,
+                          unsigned index,
+                          unsigned v)
+{
+  // records never straddle a word boundary, so we can update all the
+  // bits of one with a single compare-and-swap:
+  uintptr_t* p = map + wordOf(index);
+  uintptr_t mask = 0;
+  uintptr_t bits = 0;
+  for (unsigned i = 0; i < bitsPerRecord; ++i) {
+    uintptr_t bit = static_cast<uintptr_t>(1) << bitOf(index + i);
+    mask |= bit;
+    if ((v >> (bitsPerRecord - i - 1)) & 1) {
+      bits |= bit;
+    }
+  }
+
+  for (uintptr_t old = *p;
+       not atomicCompareAndSwap(p, old, (old & ~mask) | bits);
+       old = *p) {
+  }
+}
 #endif  // USE_ATOMIC_OPERATIONS
 
 inline void* get(void* o, unsigned offsetInWords)
@@ -344,6 +385,11 @@ class Segment {
     }
 
 #ifdef USE_ATOMIC_OPERATIONS
+    void setOnlyAtomic(void* p, unsigned v)
+    {
+      setBitsAtomic(data, bitsPerRecord, indexOf(p), v);
+    }
+
     void markAtomic(void* p)
     {
       assertT(segment->context, bitsPerRecord == 1);
@@ -378,14 +424,15 @@ class Segment {
         minimum = 1;
       }
 
+      assertT(context, minimum <= MaxSegmentCapacityInWords);
       assertT(context, desired >= minimum);
 
-      capacity_ = desired;
+      capacity_ = min(desired, MaxSegmentCapacityInWords);
 
       if (static_cast<int64_t>(footprint(capacity_)) > available) {
         unsigned top = capacity_;
         unsigned bottom = minimum;
-        unsigned target = available;
+        int64_t target = available;
         while (true) {
           if (static_cast<int64_t>(footprint(capacity_)) > target) {
             if (bottom == capacity_) {
@@ -412,7 +459,7 @@ class Segment {
 
       while (data == 0) {
         data = static_cast<uintptr_t*>(local::allocate(
-            context, (footprint(capacity_)) * BytesPerWord, false));
+            context, footprintInBytes(capacity_), false));
 
         if (data == 0) {
           if (capacity_ > minimum) {
@@ -422,7 +469,7 @@ class Segment {
             }
           } else {
             data = static_cast<uintptr_t*>(local::allocate(
-                context, (footprint(capacity_)) * BytesPerWord));
+                context, footprintInBytes(capacity_)));
           }
         }
       }
@@ -455,6 +502,11 @@ class Segment {
            + (map and capacity ? map->calculateFootprint(capacity) : 0);
   }
 
+  size_t footprintInBytes(unsigned capacity)
+  {
+    return static_cast<size_t>(footprint(capacity)) * BytesPerWord;
+  }
+
   unsigned capacity()
   {
     return capacity_;
@@ -473,7 +525,7 @@ class Segment {
   void replaceWith(Segment* s)
   {
     if (data) {
-      free(context, data, (footprint(capacity())) * BytesPerWord);
+      free(context, data, footprintInBytes(capacity()));
     }
     data = s->data;
     s->data = 0;
@@ -528,16 +580,85 @@ class Segment {
     return p;
   }
 
+#ifdef USE_ATOMIC_OPERATIONS
+  // allocates between minimum and desired words, returning the amount
+  // allocated via size, or returns null if fewer than minimum words
+  // remain.  This may be called concurrently by parallel collectors.
+  uintptr_t* allocateAtomic(unsigned minimum, unsigned desired, unsigned* size)
+  {
+    while (true) {
+      unsigned p = *static_cast<volatile unsigned*>(&position_);
+      unsigned n = min(desired, capacity() - p);
+      if (n < minimum) {
+        return 0;
+      }
+
+      if (atomicCompareAndSwap32(
+              reinterpret_cast<uint32_t*>(&position_), p, p + n)) {
+        *size = n;
+        return data + p;
+      }
+    }
+  }
+#endif  // USE_ATOMIC_OPERATIONS
+
   void dispose()
   {
     if (data) {
-      free(context, data, (footprint(capacity())) * BytesPerWord);
+      free(context, data, footprintInBytes(capacity()));
     }
     data = 0;
     map = 0;
   }
 };
 
+inline unsigned cardCount(Segment* s)
+{
+  return ceilingDivide(s->capacity(), CardSizeInWords);
+}
+
+inline unsigned bitmapSize(Segment* s)
+{
+  return ceilingDivide(s->capacity(), BitsPerWord);
+}
+
+// allocates a zeroed bitmap with one bit per word of the specified
+// segment
+uintptr_t* allocateBitmap(Context* c, Segment* s)
+{
+  uintptr_t* map = static_cast<uintptr_t*>(
+      allocate(c, bitmapSize(s) * BytesPerWord));
+  memset(map, 0, bitmapSize(s) * BytesPerWord);
+  return map;
+}
+
+void freeBitmap(Context* c, Segment* s, uintptr_t* map)
+{
+  free(c, map, bitmapSize(s) * BytesPerWord);
+}
+
+void allocateCards(Context* c,
+                   Segment* s,
+                   uint8_t** cards,
+                   uintptr_t** startMap)
+{
+  *cards = static_cast<uint8_t*>(allocate(c, cardCount(s)));
+  memset(*cards, 0, cardCount(s));
+
+  *startMap = allocateBitmap(c, s);
+}
+
+void freeCards(Context* c, Segment* s, uint8_t** cards, uintptr_t** startMap)
+{
+  if (*cards) {
+    free(c, *cards, cardCount(s));
+    *cards = 0;
+
+    freeBitmap(c, s, *startMap);
+    *startMap = 0;
+  }
+}
+
 class Fixie {
  public:
   static const unsigned HasMask = 1 << 0;
@@ -693,9 +814,12 @@ Fixie* fixie(void* body)
 
 void free(Context* c, Fixie** fixies, bool resetImmortal = false);
 
+class Collector;
+class Slot;
+
 class Context {
  public:
-  Context(System* system, unsigned limit)
+  Context(System* system, size_t limit)
       : system(system),
         client(0),
         count(0),
@@ -743,8 +867,36 @@ class Context {
         lastCollectionTime(system->now()),
         totalCollectionTime(0),
         totalTime(0),
-        limitWasExceeded(false)
+        limitWasExceeded(false),
+        collectorCount(1),
+        collectors(0),
+        collectorMonitor(0),
+        collectorEpoch(0),
+        collectorsFinished(0),
+        collectorsShutdown(false),
+        gatheringRoots(false),
+        roots(0),
+        rootCount(0),
+        rootCapacity(0),
+        rootIndex(0),
+        idleCollectors(0),
+        markGen2InPlace(false),
+        compactGen2(false),
+        gen2Top(0),
+        gen2Free(0),
+        liveMap(0),
+        freshMap(0),
+        markStack(0),
+        markStackSize(0),
+        markStackCapacity(0),
+        gen2Cards(0),
+        nextGen2Cards(0),
+        startMap(0),
+        nextStartMap(0)
   {
+    memset(freeLists, 0, sizeof(freeLists));
+    memset(&cardTable, 0, sizeof(cardTable));
+
     if (not system->success(system->make(&lock))) {
       system->abort();
     }
@@ -752,10 +904,18 @@ class Context {
 
   void dispose()
   {
+    freeCards(this, &gen2, &gen2Cards, &startMap);
+    freeCards(this, &nextGen2, &nextGen2Cards, &nextStartMap);
+
     gen1.dispose();
     nextGen1.dispose();
     gen2.dispose();
     nextGen2.dispose();
+
+    if (markStack) {
+      free(this, markStack, markStackCapacity * BytesPerWord);
+    }
+
     lock->dispose();
   }
 
@@ -769,8 +929,8 @@ class Context {
   System* system;
   Heap::Client* client;
 
-  unsigned count;
-  unsigned limit;
+  size_t count;
+  size_t limit;
 
   System::Mutex* lock;
 
@@ -802,10 +962,10 @@ class Context {
   unsigned tenurePadding;
   unsigned gen2Padding;
 
-  unsigned fixieTenureFootprint;
-  unsigned untenuredFixieFootprint;
-  unsigned tenuredFixieFootprint;
-  unsigned tenuredFixieCeiling;
+  size_t fixieTenureFootprint;
+  size_t untenuredFixieFootprint;
+  size_t tenuredFixieFootprint;
+  size_t tenuredFixieCeiling;
 
   Heap::CollectionType mode;
 
@@ -820,6 +980,44 @@ class Context {
   int64_t totalTime;
 
   bool limitWasExceeded;
+
+  // state for parallel minor collections (see collectInParallel):
+  unsigned collectorCount;
+  Collector* collectors;
+  System::Monitor* collectorMonitor;
+  unsigned collectorEpoch;
+  unsigned collectorsFinished;
+  bool collectorsShutdown;
+
+  bool gatheringRoots;
+  Slot* roots;
+  unsigned rootCount;
+  unsigned rootCapacity;
+  uint32_t rootIndex;
+  uint32_t idleCollectors;
+
+  // state for major collections which mark gen2 in place rather than
+  // copying it (see collect(Context*)):
+  bool markGen2InPlace;
+  bool compactGen2;
+  unsigned gen2Top;
+  unsigned gen2Free;
+  uintptr_t* freeLists[FreeListCount];
+  uintptr_t* liveMap;
+  uintptr_t* freshMap;
+  void** markStack;
+  unsigned markStackSize;
+  unsigned markStackCapacity;
+
+  // the card table (see Heap::CardTable) normally covers gen2, but
+  // covers nextGen2 for the duration of a copying major collection.
+  // Each object in gen2 has a bit set in startMap at the index of its
+  // first word, which allows us to find the objects on a dirty card:
+  Heap::CardTable cardTable;
+  uint8_t* gen2Cards;
+  uint8_t* nextGen2Cards;
+  uintptr_t* startMap;
+  uintptr_t* nextStartMap;
 };
 
 const char* segment(Context* c, void* p)
@@ -842,22 +1040,47 @@ inline Aborter* getAborter(Context* c)
   return c->system;
 }
 
+// parallel collectors copy objects into per-collector buffers, and
+// some space may be left over at the end of each buffer, so we must
+// allow for that when sizing the destination segments:
+inline unsigned parallelSlack(Context* c, unsigned footprint)
+{
+  if (c->collectorCount > 1 and c->mode == Heap::MinorCollection) {
+    return (footprint / 7) + (2 * c->collectorCount * CopyBufferSizeInWords);
+  } else {
+    return 0;
+  }
+}
+
 inline unsigned minimumNextGen1Capacity(Context* c)
 {
-  return c->gen1.position() - c->tenureFootprint + c->incomingFootprint
-         + c->gen1Padding;
+  unsigned minimum = c->gen1.position() - c->tenureFootprint
+                     + c->incomingFootprint + c->gen1Padding;
+
+  return minimum + parallelSlack(c, minimum);
+}
+
+inline bool undersizedGen2(Context* c)
+{
+  return c->tenureFootprint + c->tenurePadding
+         + parallelSlack(c, c->tenureFootprint) > c->gen2.remaining();
 }
 
 inline unsigned minimumNextGen2Capacity(Context* c)
 {
-  return c->gen2.position() + c->tenureFootprint + c->tenurePadding
-         + c->gen2Padding;
+  return c->gen2.position() - c->gen2Free + c->tenureFootprint
+         + c->tenurePadding + c->gen2Padding;
 }
 
 inline bool oversizedGen2(Context* c)
 {
   return c->gen2.capacity() > (InitialGen2CapacityInBytes / BytesPerWord)
-         and c->gen2.position() < (c->gen2.capacity() / 4);
+         and c->gen2.position() - c->gen2Free < (c->gen2.capacity() / 4);
+}
+
+inline bool fragmentedGen2(Context* c)
+{
+  return c->gen2Free > c->gen2.position() / 2;
 }
 
 inline void initNextGen1(Context* c)
@@ -872,11 +1095,18 @@ inline void initNextGen1(Context* c)
 
   if (Verbose2) {
     fprintf(stderr,
-            "init nextGen1 to %d bytes\n",
-            c->nextGen1.capacity() * BytesPerWord);
+            "init nextGen1 to %" LLD " bytes\n",
+            static_cast<int64_t>(c->nextGen1.capacity()) * BytesPerWord);
   }
 }
 
+void useCards(Context* c, Segment* s, uint8_t* cards)
+{
+  c->cardTable.start = reinterpret_cast<uintptr_t>(s->data);
+  c->cardTable.count = cardCount(s);
+  c->cardTable.cards = cards;
+}
+
 inline void initNextGen2(Context* c)
 {
   new (&(c->nextPointerMap)) Segment::Map(&(c->nextGen2), 1, 1, 0, true);
@@ -894,7 +1124,7 @@ inline void initNextGen2(Context* c)
   unsigned desired = minimum;
 
   if (not oversizedGen2(c)) {
-    desired *= 2;
+    desired = min(desired, MaxSegmentCapacityInWords / 2) * 2;
   }
 
   if (desired < InitialGen2CapacityInBytes / BytesPerWord) {
@@ -911,17 +1141,22 @@ inline void initNextGen2(Context* c)
          - c->gen2.footprint(c->gen2.capacity())
          - c->gen1.footprint(c->gen1.capacity()) + c->pendingAllocation));
 
+  allocateCards(c, &(c->nextGen2), &(c->nextGen2Cards), &(c->nextStartMap));
+
   if (Verbose2) {
     fprintf(stderr,
-            "init nextGen2 to %d bytes\n",
-            c->nextGen2.capacity() * BytesPerWord);
+            "init nextGen2 to %" LLD " bytes\n",
+            static_cast<int64_t>(c->nextGen2.capacity()) * BytesPerWord);
   }
 }
 
 inline bool fresh(Context* c, void* o)
 {
   return c->nextGen1.contains(o) or c->nextGen2.contains(o)
-         or (c->gen2.contains(o) and c->gen2.indexOf(o) >= c->gen2Base);
+         or (c->gen2.contains(o)
+             and (c->gen2.indexOf(o) >= c->gen2Base
+                  or (c->freshMap
+                      and getBit(c->freshMap, c->gen2.indexOf(o)))));
 }
 
 inline bool wasCollected(Context* c, void* o)
@@ -1046,15 +1281,28 @@ void sweepFixies(Context* c)
     f->marked(false);
   }
 
-  c->tenuredFixieCeiling
-      = max(c->tenuredFixieFootprint * 2, InitialTenuredFixieCeilingInBytes);
+  c->tenuredFixieCeiling = c->tenuredFixieFootprint * 2;
+  if (c->tenuredFixieCeiling < InitialTenuredFixieCeilingInBytes) {
+    c->tenuredFixieCeiling = InitialTenuredFixieCeilingInBytes;
+  }
 }
 
 inline void* copyTo(Context* c, Segment* s, void* o, unsigned size)
 {
   assertT(c, s->remaining() >= size);
   void* dst = s->allocate(size);
-  c->client->copy(o, dst);
+  c->client->copy(o, dst, fieldAtOffset<uintptr_t>(o, 0));
+  return dst;
+}
+
+inline void* copyTo(Context* c,
+                    Segment* s,
+                    uintptr_t* startMap,
+                    void* o,
+                    unsigned size)
+{
+  void* dst = copyTo(c, s, o, size);
+  markBit(startMap, s->indexOf(dst));
   return dst;
 }
 
@@ -1063,27 +1311,172 @@ bool immortalHeapContains(Context* c, void* p)
   return p < c->immortalHeapEnd and p >= c->immortalHeapStart;
 }
 
+void markRange(uintptr_t* map, unsigned start, unsigned end)
+{
+  for (unsigned i = start; i < end; ++i) {
+    markBit(map, i);
+  }
+}
+
+void clearRange(uintptr_t* map, unsigned start, unsigned end)
+{
+  unsigned i = start;
+  for (; i < end and bitOf(i); ++i) {
+    clearBit(map, i);
+  }
+
+  unsigned words = wordOf(end) - wordOf(i);
+  if (i < end and words) {
+    memset(map + wordOf(i), 0, words * BytesPerWord);
+    i = indexOf(wordOf(end), 0);
+  }
+
+  for (; i < end; ++i) {
+    clearBit(map, i);
+  }
+}
+
+// returns the index of the first bit in [start, end) whose value is
+// v, or end if there is none
+unsigned find(uintptr_t* map, unsigned start, unsigned end, bool v)
+{
+  unsigned i = start;
+  while (i < end) {
+    uintptr_t w = map[wordOf(i)];
+    if (not v) {
+      w = ~w;
+    }
+    w >>= bitOf(i);
+
+    if (w) {
+      while ((w & 1) == 0) {
+        w >>= 1;
+        ++i;
+      }
+      return min(i, end);
+    }
+
+    i = indexOf(wordOf(i) + 1, 0);
+  }
+  return end;
+}
+
+void clearMap(Segment::Map* map)
+{
+  memset(map->data, 0, map->size() * BytesPerWord);
+  if (map->child) {
+    clearMap(map->child);
+  }
+}
+
+// Free chunks in gen2 are kept in segregated lists, where list i
+// holds chunks of between 2^i and 2^(i+1) - 1 words.  The first word
+// of each chunk holds its size and the second a pointer to the next
+// chunk in the same list.
+void addFreeChunk(Context* c, unsigned start, unsigned size)
+{
+  if (size >= MinimumFreeChunkSizeInWords) {
+    uintptr_t* p = static_cast<uintptr_t*>(c->gen2.get(start));
+    unsigned index = log(size + 1) - 1;
+
+    p[0] = size;
+    p[1] = reinterpret_cast<uintptr_t>(c->freeLists[index]);
+    c->freeLists[index] = p;
+    c->gen2Free += size;
+  }
+}
+
+void resetFreeLists(Context* c)
+{
+  memset(c->freeLists, 0, sizeof(c->freeLists));
+  c->gen2Free = 0;
+}
+
+uintptr_t* allocateFree(Context* c, unsigned size)
+{
+  if (c->gen2Free) {
+    for (unsigned i = log(size); i < FreeListCount; ++i) {
+      uintptr_t* p = c->freeLists[i];
+      if (p) {
+        unsigned chunkSize = p[0];
+        c->freeLists[i] = reinterpret_cast<uintptr_t*>(p[1]);
+        c->gen2Free -= chunkSize;
+
+        addFreeChunk(c, c->gen2.indexOf(p) + size, chunkSize - size);
+
+        return p;
+      }
+    }
+  }
+  return 0;
+}
+
+void* tenure(Context* c, void* o, unsigned size)
+{
+  uintptr_t* dst = allocateFree(c, size);
+  if (dst) {
+    unsigned index = c->gen2.indexOf(dst);
+
+    // we can't use gen2Base to identify this object as fresh, since it
+    // lies below it:
+    markBit(c->freshMap, index);
+    markBit(c->startMap, index);
+    if (c->liveMap) {
+      markRange(c->liveMap, index, index + size);
+    }
+
+    c->client->copy(o, dst, fieldAtOffset<uintptr_t>(o, 0));
+    return dst;
+  }
+
+  assertT(c, c->gen2.remaining() >= size);
+
+  if (c->gen2Base == Top) {
+    c->gen2Base = c->gen2.position();
+  }
+
+  return copyTo(c, &(c->gen2), c->startMap, o, size);
+}
+
+void markGen2(Context* c, void* o)
+{
+  unsigned index = c->gen2.indexOf(o);
+  if (not getBit(c->liveMap, index)) {
+    markRange(c->liveMap, index, index + c->client->sizeInWords(o));
+
+    if (c->markStackSize == c->markStackCapacity) {
+      unsigned capacity
+          = max(InitialMarkStackCapacity, c->markStackCapacity * 2);
+      void** stack
+          = static_cast<void**>(allocate(c, capacity * BytesPerWord));
+      if (c->markStack) {
+        memcpy(stack, c->markStack, c->markStackSize * BytesPerWord);
+        free(c, c->markStack, c->markStackCapacity * BytesPerWord);
+      }
+      c->markStack = stack;
+      c->markStackCapacity = capacity;
+    }
+
+    c->markStack[c->markStackSize++] = o;
+  }
+}
+
 void* copy2(Context* c, void* o)
 {
-  unsigned size = c->client->copiedSizeInWords(o);
+  unsigned size
+      = c->client->copiedSizeInWords(o, fieldAtOffset<uintptr_t>(o, 0));
 
   if (c->gen2.contains(o)) {
     assertT(c, c->mode == Heap::MajorCollection);
 
-    return copyTo(c, &(c->nextGen2), o, size);
+    return copyTo(c, &(c->nextGen2), c->nextStartMap, o, size);
   } else if (c->gen1.contains(o)) {
     unsigned age = c->ageMap.get(o);
     if (age == TenureThreshold) {
-      if (c->mode == Heap::MinorCollection) {
-        assertT(c, c->gen2.remaining() >= size);
-
-        if (c->gen2Base == Top) {
-          c->gen2Base = c->gen2.position();
-        }
-
-        return copyTo(c, &(c->gen2), o, size);
+      if (c->mode == Heap::MinorCollection or c->markGen2InPlace) {
+        return tenure(c, o, size);
       } else {
-        return copyTo(c, &(c->nextGen2), o, size);
+        return copyTo(c, &(c->nextGen2), c->nextStartMap, o, size);
       }
     } else {
       o = copyTo(c, &(c->nextGen1), o, size);
@@ -1156,9 +1549,17 @@ void* update3(Context* c, void* o, bool* needsVisit)
 
 void* update2(Context* c, void* o, bool* needsVisit)
 {
-  if (c->mode == Heap::MinorCollection and c->gen2.contains(o)) {
-    *needsVisit = false;
-    return o;
+  if (c->gen2.contains(o)) {
+    if (c->mode == Heap::MinorCollection) {
+      *needsVisit = false;
+      return o;
+    } else if (c->markGen2InPlace) {
+      if (not fresh(c, o)) {
+        markGen2(c, o);
+      }
+      *needsVisit = false;
+      return o;
+    }
   }
 
   return update3(c, o, needsVisit);
@@ -1199,7 +1600,7 @@ void updateHeapMap(Context* c,
   Segment* seg;
   Segment::Map* map;
 
-  if (c->mode == Heap::MinorCollection) {
+  if (c->mode == Heap::MinorCollection or c->markGen2InPlace) {
     seg = &(c->gen2);
     map = &(c->heapMap);
   } else {
@@ -1672,6 +2073,112 @@ void visitMarkedFixies(Context* c)
   }
 }
 
+void visitMarkedGen2(Context* c)
+{
+  while (c->markStackSize) {
+    void* o = c->markStack[--c->markStackSize];
+
+    class Walker : public Heap::Walker {
+     public:
+      Walker(Context* c, void* o) : c(c), o(o)
+      {
+      }
+
+      virtual bool visit(unsigned offset)
+      {
+        local::collect(c, o, offset);
+        return true;
+      }
+
+      Context* c;
+      void* o;
+    } w(c, o);
+
+    c->client->walk(o, &w);
+  }
+}
+
+void visitMarked(Context* c)
+{
+  while (c->markedFixies or c->markStackSize) {
+    visitMarkedFixies(c);
+    visitMarkedGen2(c);
+  }
+}
+
+bool targetNeedsMark(Context* c, void* target)
+{
+  return target and not c->gen2.contains(target)
+         and not c->nextGen2.contains(target)
+         and not immortalHeapContains(c, target)
+         and not(c->client->isFixed(target)
+                 and fixie(target)->age >= FixieTenureThreshold);
+}
+
+// adds to the remembered set any references to younger objects held
+// by gen2 objects whose cards have been marked since the last
+// collection
+void scanCards(Context* c)
+{
+  class Walker : public Heap::Walker {
+   public:
+    Walker(Context* c) : c(c), o(0)
+    {
+    }
+
+    virtual bool visit(unsigned offset)
+    {
+      if (targetNeedsMark(c, get(o, offset))) {
+        c->heapMap.set(getp(o, offset));
+      }
+      return true;
+    }
+
+    Context* c;
+    void* o;
+  } w(c);
+
+  unsigned position = c->gen2.position();
+  unsigned count = ceilingDivide(position, CardSizeInWords);
+  for (unsigned i = 0; i < count; ++i) {
+    if (c->gen2Cards[i]) {
+      c->gen2Cards[i] = 0;
+
+      unsigned end = min((i + 1) * CardSizeInWords, position);
+      for (unsigned j = find(c->startMap, i * CardSizeInWords, end, true);
+           j < end;
+           j = find(c->startMap, j + 1, end, true)) {
+        w.o = c->gen2.get(j);
+        c->client->walk(w.o, &w);
+      }
+    }
+  }
+}
+
+// rebuilds the gen2 free lists from the holes left between the objects
+// marked by an in-place major collection
+void sweepGen2(Context* c)
+{
+  resetFreeLists(c);
+
+  unsigned end = c->gen2Top;
+  unsigned i = 0;
+  while (i < end) {
+    unsigned start = find(c->liveMap, i, end, false);
+    i = find(c->liveMap, start, end, true);
+
+    clearRange(c->startMap, start, i);
+
+    if (i == end and c->gen2.position() == end) {
+      // the hole extends to the end of the segment, so just give it
+      // back to the bump allocator
+      c->gen2.position_ = start;
+    } else {
+      addFreeChunk(c, start, i - start);
+    }
+  }
+}
+
 void collect(Context* c,
              Segment::Map* map,
              unsigned start,
@@ -1716,80 +2223,817 @@ void collect(Context* c,
   assertT(c, wasDirty or not expectDirty);
 }
 
-void collect2(Context* c)
-{
-  c->gen2Base = Top;
-  c->tenureFootprint = 0;
-  c->fixieTenureFootprint = 0;
-  c->gen1Padding = 0;
-  c->tenurePadding = 0;
+#ifdef USE_ATOMIC_OPERATIONS
 
-  if (c->mode == Heap::MajorCollection) {
-    c->gen2Padding = 0;
-  }
+// a reference to be updated by the parallel collector, along with the
+// object (if any) containing it:
+class Slot {
+ public:
+  void** p;
+  void* target;
+  unsigned offset;
+};
 
-  if (c->mode == Heap::MinorCollection and c->gen2.position()) {
-    unsigned start = 0;
-    unsigned end = start + c->gen2.position();
-    bool dirty;
-    collect(c, &(c->heapMap), start, end, &dirty, false);
+// a Chase-Lev work-stealing deque of objects whose fields have yet to
+// be visited.  Only the owning collector may push or pop, while any
+// collector may steal.
+class WorkQueue {
+ public:
+  class Buffer {
+   public:
+    Buffer* next;
+    unsigned capacity;
+    void** items;
+  };
+
+  void init(Context* c)
+  {
+    buffer = makeBuffer(c, InitialWorkQueueCapacity, 0);
+    top = 0;
+    bottom = 0;
   }
 
-  if (c->mode == Heap::MinorCollection) {
-    visitDirtyFixies(c, &(c->dirtyTenuredFixies));
+  Buffer* makeBuffer(Context* c, unsigned capacity, Buffer* next)
+  {
+    Buffer* b = static_cast<Buffer*>(
+        allocate(c, sizeof(Buffer) + (capacity * BytesPerWord)));
+    b->next = next;
+    b->capacity = capacity;
+    b->items = reinterpret_cast<void**>(b + 1);
+    return b;
   }
 
-  class Visitor : public Heap::Visitor {
-   public:
-    Visitor(Context* c) : c(c)
-    {
+  void grow(Context* c, uint32_t t, uint32_t b)
+  {
+    Buffer* old = buffer;
+    Buffer* new_ = makeBuffer(c, old->capacity * 2, old);
+    for (uint32_t i = t; i != b; ++i) {
+      new_->items[i % new_->capacity] = old->items[i % old->capacity];
     }
 
-    virtual void visit(void* p)
-    {
-      local::collect(c, static_cast<void**>(p));
-      visitMarkedFixies(c);
+    // the old buffer may still be read by concurrent stealers, so we
+    // keep it around until the collection is finished:
+    storeStoreMemoryBarrier();
+    buffer = new_;
+  }
+
+  void push(Context* c, void* o)
+  {
+    uint32_t b = bottom;
+    uint32_t t = *static_cast<volatile uint32_t*>(&top);
+    if (b - t >= buffer->capacity) {
+      grow(c, t, b);
     }
 
-    Context* c;
-  } v(c);
+    buffer->items[b % buffer->capacity] = o;
+    storeStoreMemoryBarrier();
+    bottom = b + 1;
+  }
 
-  c->client->visitRoots(&v);
-}
+  void* pop()
+  {
+    uint32_t b = bottom - 1;
+    bottom = b;
+    storeLoadMemoryBarrier();
+    uint32_t t = *static_cast<volatile uint32_t*>(&top);
 
-bool limitExceeded(Context* c, int pendingAllocation)
-{
-  unsigned count = c->count + pendingAllocation
-                   - (c->gen2.remaining() * BytesPerWord);
+    if (static_cast<int32_t>(b - t) < 0) {
+      bottom = t;
+      return 0;
+    }
 
-  if (Verbose) {
-    if (count > c->limit) {
-      if (not c->limitWasExceeded) {
-        c->limitWasExceeded = true;
-        fprintf(stderr, "heap limit %d exceeded: %d\n", c->limit, count);
+    void* o = buffer->items[b % buffer->capacity];
+    if (b == t) {
+      // this is the last item, so we must race with any stealers for it:
+      if (not atomicCompareAndSwap32(&top, t, t + 1)) {
+        o = 0;
       }
-    } else if (c->limitWasExceeded) {
-      c->limitWasExceeded = false;
-      fprintf(
-          stderr, "heap limit %d no longer exceeded: %d\n", c->limit, count);
+      bottom = t + 1;
     }
+
+    return o;
   }
 
-  return count > c->limit;
-}
+  void* steal()
+  {
+    uint32_t t = *static_cast<volatile uint32_t*>(&top);
+    storeLoadMemoryBarrier();
+    uint32_t b = *static_cast<volatile uint32_t*>(&bottom);
 
-void collect(Context* c)
-{
-  if (limitExceeded(c, c->pendingAllocation) or oversizedGen2(c)
-      or c->tenureFootprint + c->tenurePadding > c->gen2.remaining()
-      or c->fixieTenureFootprint + c->tenuredFixieFootprint
+    if (static_cast<int32_t>(b - t) <= 0) {
+      return 0;
+    }
+
+    loadMemoryBarrier();
+    Buffer* buf = *static_cast<Buffer* volatile*>(&buffer);
+    void* o = buf->items[t % buf->capacity];
+    if (atomicCompareAndSwap32(&top, t, t + 1)) {
+      return o;
+    } else {
+      return 0;
+    }
+  }
+
+  bool empty()
+  {
+    return static_cast<int32_t>(*static_cast<volatile uint32_t*>(&bottom)
+                                - *static_cast<volatile uint32_t*>(&top))
+           <= 0;
+  }
+
+  void reset(Context* c)
+  {
+    // release all but the most recent buffer:
+    while (buffer->next) {
+      Buffer* b = buffer->next;
+      buffer->next = b->next;
+      free(c, b, sizeof(Buffer) + (b->capacity * BytesPerWord));
+    }
+    top = 0;
+    bottom = 0;
+  }
+
+  void dispose(Context* c)
+  {
+    reset(c);
+    free(c, buffer, sizeof(Buffer) + (buffer->capacity * BytesPerWord));
+  }
+
+  Buffer* buffer;
+  uint32_t top;
+  uint32_t bottom;
+};
+
+class CopyBuffer {
+ public:
+  uintptr_t* position;
+  uintptr_t* limit;
+};
+
+void collectInParallel(Context* c, Collector* collector);
+
+class Collector : public System::Runnable {
+ public:
+  Collector(Context* c, unsigned index)
+      : c(c), index(index), thread(0), tenureFootprint(0)
+  {
+    queue.init(c);
+  }
+
+  virtual void attach(System::Thread* t)
+  {
+    thread = t;
+  }
+
+  virtual void run()
+  {
+    unsigned epoch = 0;
+    while (true) {
+      {
+        System::MonitorResource lock(thread, c->collectorMonitor);
+
+        while (epoch == c->collectorEpoch and not c->collectorsShutdown) {
+          c->collectorMonitor->wait(thread, 0);
+        }
+
+        if (c->collectorsShutdown) {
+          return;
+        }
+
+        epoch = c->collectorEpoch;
+      }
+
+      collectInParallel(c, this);
+
+      {
+        System::MonitorResource lock(thread, c->collectorMonitor);
+
+        ++c->collectorsFinished;
+        c->collectorMonitor->notifyAll(thread);
+      }
+    }
+  }
+
+  virtual bool interrupted()
+  {
+    return false;
+  }
+
+  virtual void setInterrupted(bool)
+  {
+  }
+
+  Context* c;
+  unsigned index;
+  System::Thread* thread;
+  WorkQueue queue;
+  CopyBuffer gen1Buffer;
+  CopyBuffer gen2Buffer;
+  unsigned tenureFootprint;
+};
+
+// a word whose address is stored in the header of an object while a
+// collector is copying it.  Since it is aligned and lies outside the
+// heap, it is neither mistaken for a fixie mark nor for a forwarding
+// pointer.
+uintptr_t busyHeader;
+
+inline uintptr_t busy()
+{
+  return reinterpret_cast<uintptr_t>(&busyHeader);
+}
+
+void addRoot(Context* c, void** p, void* target, unsigned offset)
+{
+  if (c->rootCount == c->rootCapacity) {
+    unsigned capacity = max(256, c->rootCapacity * 2);
+    Slot* roots = static_cast<Slot*>(allocate(c, capacity * sizeof(Slot)));
+    if (c->roots) {
+      memcpy(roots, c->roots, c->rootCount * sizeof(Slot));
+      free(c, c->roots, c->rootCapacity * sizeof(Slot));
+    }
+    c->roots = roots;
+    c->rootCapacity = capacity;
+  }
+
+  Slot* s = c->roots + (c->rootCount++);
+  s->p = p;
+  s->target = target;
+  s->offset = offset;
+}
+
+void gatherDirtyReferences(Context* c,
+                           Segment::Map* map,
+                           unsigned start,
+                           unsigned end)
+{
+  for (Segment::Map::Iterator it(map, start, end); it.hasMore();) {
+    if (map->child) {
+      unsigned s = it.next();
+      map->clearOnly(s);
+      gatherDirtyReferences(c, map->child, s, s + map->scale);
+    } else {
+      void** p = reinterpret_cast<void**>(map->segment->get(it.next()));
+      // the bits will be set again as needed by updateHeapMapInParallel
+      map->clearOnly(p);
+      addRoot(c, p, 0, 0);
+    }
+  }
+}
+
+void gatherDirtyFixies(Context* c)
+{
+  for (Fixie* f = c->dirtyTenuredFixies; f; f = f->next) {
+    uintptr_t* mask = f->mask();
+    for (unsigned i = 0; i < f->size; ++i) {
+      if (getBit(mask, i)) {
+        clearBit(mask, i);
+        addRoot(c, getp(f->body(), i), f->body(), i);
+      }
+    }
+  }
+}
+
+void cleanDirtyFixies(Context* c)
+{
+  for (Fixie** p = &(c->dirtyTenuredFixies); *p;) {
+    Fixie* f = *p;
+    bool clean = true;
+    for (unsigned i = 0; i < f->size; ++i) {
+      if (getBit(f->mask(), i)) {
+        clean = false;
+        break;
+      }
+    }
+
+    if (clean) {
+      markClean(c, f);
+    } else {
+      p = &(f->next);
+    }
+  }
+}
+
+uintptr_t* allocate(Context* c, Segment* s, CopyBuffer* b, unsigned size)
+{
+  unsigned available = b->limit - b->position;
+  if (size > available) {
+    unsigned n;
+    if (size > CopyBufferSizeInWords / 8
+        or available >= CopyBufferSizeInWords / 8) {
+      // allocate large objects directly from the segment, and avoid
+      // discarding a buffer with plenty of space left in it:
+      uintptr_t* p = s->allocateAtomic(size, size, &n);
+      expect(c->system, p);
+      return p;
+    }
+
+    uintptr_t* p = s->allocateAtomic(size, CopyBufferSizeInWords, &n);
+    expect(c->system, p);
+    b->position = p;
+    b->limit = p + n;
+  }
+
+  uintptr_t* p = b->position;
+  b->position += size;
+  return p;
+}
+
+void releaseBuffer(Segment* s, CopyBuffer* b)
+{
+  // return the unused part of the buffer if it lies at the end of the
+  // segment:
+  if (b->limit == s->data + s->position_) {
+    s->position_ -= b->limit - b->position;
+  }
+  b->position = b->limit = 0;
+}
+
+void* copyInParallel(Context* c, Collector* w, void* o, uintptr_t header)
+{
+  unsigned size = c->client->copiedSizeInWords(o, header);
+
+  uintptr_t* dst;
+  if (c->gen1.contains(o)) {
+    unsigned age = c->ageMap.get(o);
+    if (age == TenureThreshold) {
+      dst = allocate(c, &(c->gen2), &(w->gen2Buffer), size);
+      markBitAtomic(c->startMap, c->gen2.indexOf(dst));
+    } else {
+      dst = allocate(c, &(c->nextGen1), &(w->gen1Buffer), size);
+
+      c->nextAgeMap.setOnlyAtomic(dst, age + 1);
+      if (age + 1 == TenureThreshold) {
+        w->tenureFootprint += size;
+      }
+    }
+  } else {
+    assertT(c, not immortalHeapContains(c, o));
+
+    dst = allocate(c, &(c->nextGen1), &(w->gen1Buffer), size);
+
+    c->nextAgeMap.setOnlyAtomic(dst, 0);
+  }
+
+  c->client->copy(o, dst, header);
+
+  if (Debug) {
+    fprintf(stderr,
+            "copy %p (%s) to %p (%s)\n",
+            o,
+            segment(c, o),
+            dst,
+            segment(c, dst));
+  }
+
+  return dst;
+}
+
+void* claim(Context* c, Collector* w, void* o)
+{
+  uintptr_t* header = &fieldAtOffset<uintptr_t>(o, 0);
+  while (true) {
+    uintptr_t h = *static_cast<volatile uintptr_t*>(header);
+    if (h == busy()) {
+      // another collector is copying this object, so we wait for it
+      // to leave a forwarding pointer
+      continue;
+    } else if (fresh(c, reinterpret_cast<void*>(h))) {
+      loadMemoryBarrier();
+      return reinterpret_cast<void*>(h);
+    } else if (atomicCompareAndSwap(header, h, busy())) {
+      void* dst = copyInParallel(c, w, o, h);
+
+      // publish the copy only once it is complete:
+      storeStoreMemoryBarrier();
+      *static_cast<volatile uintptr_t*>(header)
+          = reinterpret_cast<uintptr_t>(dst);
+
+      w->queue.push(c, dst);
+      return dst;
+    }
+  }
+}
+
+void markFixieInParallel(Context* c, Collector* w, Fixie* f)
+{
+  if ((not f->marked()) and f->age < FixieTenureThreshold) {
+    bool marked = false;
+    {
+      ACQUIRE(c->lock);
+
+      if (not f->marked()) {
+        if (DebugFixies) {
+          fprintf(stderr, "mark fixie %p\n", f);
+        }
+        f->marked(true);
+        f->dead(false);
+        f->move(c, &(c->markedFixies));
+        marked = true;
+      }
+    }
+
+    if (marked) {
+      // tag the body pointer so we can distinguish it from objects in
+      // the queue
+      uintptr_t tagged = reinterpret_cast<uintptr_t>(f->body()) | 1;
+      w->queue.push(c, reinterpret_cast<void*>(tagged));
+    }
+  }
+}
+
+void* updateInParallel(Context* c, Collector* w, void* o)
+{
+  if (c->client->isFixed(o)) {
+    markFixieInParallel(c, w, fixie(o));
+    return o;
+  } else if (immortalHeapContains(c, o) or c->gen2.contains(o)
+             or c->nextGen1.contains(o)) {
+    return o;
+  } else {
+    return claim(c, w, o);
+  }
+}
+
+void updateHeapMapInParallel(Context* c,
+                             void** p,
+                             void* target,
+                             unsigned offset,
+                             void* result)
+{
+  if (not(immortalHeapContains(c, result)
+          or (c->client->isFixed(result)
+              and fixie(result)->age >= FixieTenureThreshold)
+          or c->gen2.contains(result))) {
+    if (target and c->client->isFixed(target)) {
+      Fixie* f = fixie(target);
+      assertT(c, offset == 0 or f->hasMask());
+
+      if (static_cast<unsigned>(f->age + 1) >= FixieTenureThreshold) {
+        ACQUIRE(c->lock);
+
+        f->dirty(true);
+        markBit(f->mask(), offset);
+      }
+    } else if (c->gen2.contains(p)) {
+      c->heapMap.markAtomic(p);
+    }
+  }
+}
+
+void collectInParallel(Context* c,
+                       Collector* w,
+                       void** p,
+                       void* target,
+                       unsigned offset)
+{
+  void* o = maskAlignedPointer(*p);
+  if (o) {
+    void* result = updateInParallel(c, w, o);
+    local::set(p, result);
+    updateHeapMapInParallel(c, p, target, offset, result);
+  }
+}
+
+void scan(Context* c, Collector* w, void* item)
+{
+  uintptr_t tagged = reinterpret_cast<uintptr_t>(item);
+  void* o = reinterpret_cast<void*>(tagged & ~static_cast<uintptr_t>(1));
+
+  class Walker : public Heap::Walker {
+   public:
+    Walker(Context* c, Collector* w, void* o) : c(c), w(w), o(o)
+    {
+    }
+
+    virtual bool visit(unsigned offset)
+    {
+      collectInParallel(c, w, getp(o, offset), o, offset);
+      return true;
+    }
+
+    Context* c;
+    Collector* w;
+    void* o;
+  } walker(c, w, o);
+
+  c->client->walk(o, &walker);
+
+  if (tagged & 1) {
+    ACQUIRE(c->lock);
+
+    fixie(o)->move(c, &(c->visitedFixies));
+  }
+}
+
+bool claimRoots(Context* c, Collector* w)
+{
+  while (true) {
+    uint32_t start = *static_cast<volatile uint32_t*>(&(c->rootIndex));
+    if (start >= c->rootCount) {
+      return false;
+    }
+
+    uint32_t end = min(start + RootChunkSize, c->rootCount);
+    if (atomicCompareAndSwap32(&(c->rootIndex), start, end)) {
+      for (unsigned i = start; i < end; ++i) {
+        Slot* s = c->roots + i;
+        collectInParallel(c, w, s->p, s->target, s->offset);
+      }
+      return true;
+    }
+  }
+}
+
+bool steal(Context* c, Collector* w)
+{
+  for (unsigned i = 1; i < c->collectorCount; ++i) {
+    Collector* victim = c->collectors + ((w->index + i) % c->collectorCount);
+    void* item = victim->queue.steal();
+    if (item) {
+      scan(c, w, item);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool workAvailable(Context* c)
+{
+  if (*static_cast<volatile uint32_t*>(&(c->rootIndex)) < c->rootCount) {
+    return true;
+  }
+
+  for (unsigned i = 0; i < c->collectorCount; ++i) {
+    if (not c->collectors[i].queue.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void atomicAdd(uint32_t* p, int32_t v)
+{
+  for (uint32_t old = *static_cast<volatile uint32_t*>(p);
+       not atomicCompareAndSwap32(p, old, old + v);
+       old = *static_cast<volatile uint32_t*>(p)) {
+  }
+}
+
+void collectInParallel(Context* c, Collector* w)
+{
+  while (true) {
+    for (void* item = w->queue.pop(); item; item = w->queue.pop()) {
+      scan(c, w, item);
+    }
+
+    if (claimRoots(c, w) or steal(c, w)) {
+      continue;
+    }
+
+    // we have nothing left to do, so wait until either everyone else
+    // is also idle, in which case we're done, or someone makes more
+    // work available:
+    atomicAdd(&(c->idleCollectors), 1);
+    while (true) {
+      if (*static_cast<volatile uint32_t*>(&(c->idleCollectors))
+          == c->collectorCount) {
+        return;
+      } else if (workAvailable(c)) {
+        atomicAdd(&(c->idleCollectors), -1);
+        break;
+      } else {
+        c->system->yield();
+      }
+    }
+  }
+}
+
+// Visits all the references gathered in c->roots (and everything
+// reachable from them) using c->collectorCount threads, each of which
+// copies objects into its own buffers and balances load by stealing
+// work from the others.  The copying protocol is as follows: a
+// collector claims an object by atomically replacing its header with
+// busy(), copies it, and then replaces the header with a forwarding
+// pointer.  The rest of the original object is left intact, so other
+// threads may safely read it (e.g. to find the class of an instance)
+// in the meantime.
+void collectInParallel(Context* c)
+{
+  assertT(c, c->mode == Heap::MinorCollection);
+
+  c->gatheringRoots = false;
+
+  if (c->gen2Base == Top) {
+    c->gen2Base = c->gen2.position();
+  }
+
+  c->rootIndex = 0;
+  c->idleCollectors = 0;
+
+  for (unsigned i = 0; i < c->collectorCount; ++i) {
+    Collector* w = c->collectors + i;
+    w->gen1Buffer.position = w->gen1Buffer.limit = 0;
+    w->gen2Buffer.position = w->gen2Buffer.limit = 0;
+    w->tenureFootprint = 0;
+  }
+
+  Collector* coordinator = c->collectors;
+  {
+    System::MonitorResource lock(coordinator->thread, c->collectorMonitor);
+
+    c->collectorsFinished = 0;
+    ++c->collectorEpoch;
+    c->collectorMonitor->notifyAll(coordinator->thread);
+  }
+
+  collectInParallel(c, coordinator);
+
+  {
+    System::MonitorResource lock(coordinator->thread, c->collectorMonitor);
+
+    while (c->collectorsFinished < c->collectorCount - 1) {
+      c->collectorMonitor->wait(coordinator->thread, 0);
+    }
+  }
+
+  for (unsigned i = 0; i < c->collectorCount; ++i) {
+    Collector* w = c->collectors + i;
+    releaseBuffer(&(c->nextGen1), &(w->gen1Buffer));
+    releaseBuffer(&(c->gen2), &(w->gen2Buffer));
+    c->tenureFootprint += w->tenureFootprint;
+    w->queue.reset(c);
+  }
+
+  c->rootCount = 0;
+
+  cleanDirtyFixies(c);
+}
+
+void startCollectors(Context* c, unsigned count)
+{
+  c->collectorCount = count;
+  c->collectors
+      = static_cast<Collector*>(allocate(c, count * sizeof(Collector)));
+
+  if (not c->system->success(c->system->make(&(c->collectorMonitor)))) {
+    c->system->abort();
+  }
+
+  for (unsigned i = 0; i < count; ++i) {
+    new (c->collectors + i) Collector(c, i);
+  }
+
+  // the first collector runs on whichever thread initiates the
+  // collection, so we just need a context for it to use when waiting
+  // for the others:
+  expect(c->system, c->system->success(c->system->attach(c->collectors)));
+
+  for (unsigned i = 1; i < count; ++i) {
+    expect(c->system,
+           c->system->success(c->system->start(c->collectors + i)));
+  }
+}
+
+void stopCollectors(Context* c)
+{
+  Collector* coordinator = c->collectors;
+  {
+    System::MonitorResource lock(coordinator->thread, c->collectorMonitor);
+
+    c->collectorsShutdown = true;
+    c->collectorMonitor->notifyAll(coordinator->thread);
+  }
+
+  for (unsigned i = 0; i < c->collectorCount; ++i) {
+    Collector* w = c->collectors + i;
+    if (i) {
+      w->thread->join();
+    }
+    w->thread->dispose();
+    w->queue.dispose(c);
+  }
+
+  c->collectorMonitor->dispose();
+
+  free(c, c->collectors, c->collectorCount * sizeof(Collector));
+
+  if (c->roots) {
+    free(c, c->roots, c->rootCapacity * sizeof(Slot));
+  }
+}
+
+#endif  // USE_ATOMIC_OPERATIONS
+
+void collect2(Context* c)
+{
+  c->gen2Base = Top;
+  c->tenureFootprint = 0;
+  c->fixieTenureFootprint = 0;
+  c->gen1Padding = 0;
+  c->tenurePadding = 0;
+
+  if (c->mode == Heap::MajorCollection) {
+    c->gen2Padding = 0;
+  }
+
+#ifdef USE_ATOMIC_OPERATIONS
+  if (c->mode == Heap::MinorCollection and c->collectorCount > 1) {
+    // defer visiting the roots until we've gathered them all, at
+    // which point collectInParallel will visit them concurrently
+    c->gatheringRoots = true;
+
+    if (c->gen2.position()) {
+      gatherDirtyReferences(c, &(c->heapMap), 0, c->gen2.position());
+    }
+
+    gatherDirtyFixies(c);
+  }
+#endif
+
+  if (c->mode == Heap::MinorCollection and c->gen2.position()
+      and not c->gatheringRoots) {
+    unsigned start = 0;
+    unsigned end = start + c->gen2.position();
+    bool dirty;
+    collect(c, &(c->heapMap), start, end, &dirty, false);
+  }
+
+  if (c->mode == Heap::MinorCollection and not c->gatheringRoots) {
+    visitDirtyFixies(c, &(c->dirtyTenuredFixies));
+  }
+
+  class Visitor : public Heap::Visitor {
+   public:
+    Visitor(Context* c) : c(c)
+    {
+    }
+
+    virtual void visit(void* p)
+    {
+#ifdef USE_ATOMIC_OPERATIONS
+      if (c->gatheringRoots) {
+        addRoot(c, static_cast<void**>(p), 0, 0);
+        return;
+      }
+#endif
+
+      local::collect(c, static_cast<void**>(p));
+      visitMarked(c);
+    }
+
+    Context* c;
+  } v(c);
+
+  c->client->visitRoots(&v);
+
+#ifdef USE_ATOMIC_OPERATIONS
+  // the client should have called Heap::postVisit, but just in case:
+  if (c->gatheringRoots) {
+    collectInParallel(c);
+  }
+#endif
+}
+
+bool limitExceeded(Context* c, int pendingAllocation)
+{
+  size_t count = c->count + pendingAllocation
+                 - (static_cast<size_t>(c->gen2.remaining() + c->gen2Free)
+                    * BytesPerWord);
+
+  if (Verbose) {
+    if (count > c->limit) {
+      if (not c->limitWasExceeded) {
+        c->limitWasExceeded = true;
+        fprintf(stderr,
+                "heap limit %" LLD " exceeded: %" LLD "\n",
+                static_cast<int64_t>(c->limit),
+                static_cast<int64_t>(count));
+      }
+    } else if (c->limitWasExceeded) {
+      c->limitWasExceeded = false;
+      fprintf(stderr,
+              "heap limit %" LLD " no longer exceeded: %" LLD "\n",
+              static_cast<int64_t>(c->limit),
+              static_cast<int64_t>(count));
+    }
+  }
+
+  return count > c->limit;
+}
+
+void collect(Context* c)
+{
+  if (limitExceeded(c, c->pendingAllocation) or oversizedGen2(c)
+      or undersizedGen2(c)
+      or c->fixieTenureFootprint + c->tenuredFixieFootprint
          > c->tenuredFixieCeiling) {
     if (Verbose) {
       if (limitExceeded(c, c->pendingAllocation)) {
         fprintf(stderr, "low memory causes ");
       } else if (oversizedGen2(c)) {
         fprintf(stderr, "oversized gen2 causes ");
-      } else if (c->tenureFootprint + c->tenurePadding > c->gen2.remaining()) {
+      } else if (undersizedGen2(c)) {
         fprintf(stderr, "undersized gen2 causes ");
       } else {
         fprintf(stderr, "fixie ceiling causes ");
@@ -1810,17 +3054,76 @@ void collect(Context* c)
     then = c->system->now();
   }
 
+  // unless gen2 needs to be resized or defragmented, we mark it in
+  // place during a major collection instead of copying it, which
+  // avoids allocating a second copy of the whole generation:
+  c->markGen2InPlace = c->mode == Heap::MajorCollection
+                       and c->gen2.capacity() and not c->compactGen2
+                       and not oversizedGen2(c) and not undersizedGen2(c)
+                       and not fragmentedGen2(c);
+
+  if (Verbose and c->markGen2InPlace) {
+    fprintf(stderr, "(in place) ");
+  }
+
   initNextGen1(c);
 
-  if (c->mode == Heap::MajorCollection) {
+  if (c->markGen2InPlace) {
+    c->gen2Top = c->gen2.position();
+    c->liveMap = allocateBitmap(c, &(c->gen2));
+
+    // the remembered set will be rebuilt as we visit the live objects,
+    // so we can ignore any cards marked since the last collection:
+    clearMap(&(c->heapMap));
+    memset(c->gen2Cards, 0, cardCount(&(c->gen2)));
+  } else if (c->mode == Heap::MajorCollection) {
     initNextGen2(c);
+
+    // any stores the client makes during this collection will be to
+    // objects in their new locations:
+    useCards(c, &(c->nextGen2), c->nextGen2Cards);
+  } else if (c->gen2.position()) {
+    scanCards(c);
+  }
+
+  if (c->gen2Free
+      and (c->mode == Heap::MinorCollection or c->markGen2InPlace)) {
+    c->freshMap = allocateBitmap(c, &(c->gen2));
   }
 
   collect2(c);
 
+  if (c->freshMap) {
+    freeBitmap(c, &(c->gen2), c->freshMap);
+    c->freshMap = 0;
+  }
+
   c->gen1.replaceWith(&(c->nextGen1));
-  if (c->mode == Heap::MajorCollection) {
+  if (c->markGen2InPlace) {
+    sweepGen2(c);
+
+    freeBitmap(c, &(c->gen2), c->liveMap);
+    c->liveMap = 0;
+    c->markGen2InPlace = false;
+
+    // if marking in place didn't free enough memory, compact next
+    // time:
+    if (limitExceeded(c, c->pendingAllocation)) {
+      c->compactGen2 = true;
+    }
+  } else if (c->mode == Heap::MajorCollection) {
+    freeCards(c, &(c->gen2), &(c->gen2Cards), &(c->startMap));
+
     c->gen2.replaceWith(&(c->nextGen2));
+
+    c->gen2Cards = c->nextGen2Cards;
+    c->nextGen2Cards = 0;
+    c->startMap = c->nextStartMap;
+    c->nextStartMap = 0;
+    useCards(c, &(c->gen2), c->gen2Cards);
+
+    resetFreeLists(c);
+    c->compactGen2 = false;
   }
 
   sweepFixies(c);
@@ -1844,22 +3147,22 @@ void collect(Context* c)
             static_cast<int>(c->totalTime - c->totalCollectionTime));
 
     fprintf(stderr,
-            " -             gen1: %8d/%8d bytes\n",
-            c->gen1.position() * BytesPerWord,
-            c->gen1.capacity() * BytesPerWord);
+            " -             gen1: %8" LLD "/%8" LLD " bytes\n",
+            static_cast<int64_t>(c->gen1.position()) * BytesPerWord,
+            static_cast<int64_t>(c->gen1.capacity()) * BytesPerWord);
 
     fprintf(stderr,
-            " -             gen2: %8d/%8d bytes\n",
-            c->gen2.position() * BytesPerWord,
-            c->gen2.capacity() * BytesPerWord);
+            " -             gen2: %8" LLD "/%8" LLD " bytes\n",
+            static_cast<int64_t>(c->gen2.position()) * BytesPerWord,
+            static_cast<int64_t>(c->gen2.capacity()) * BytesPerWord);
 
     fprintf(stderr,
-            " - untenured fixies:          %8d bytes\n",
-            c->untenuredFixieFootprint);
+            " - untenured fixies:          %8" LLD " bytes\n",
+            static_cast<int64_t>(c->untenuredFixieFootprint));
 
     fprintf(stderr,
-            " -   tenured fixies:          %8d bytes\n",
-            c->tenuredFixieFootprint);
+            " -   tenured fixies:          %8" LLD " bytes\n",
+            static_cast<int64_t>(c->tenuredFixieFootprint));
   }
 }
 
@@ -1932,8 +3235,14 @@ void free_(Context* c, const void* p, size_t size)
 
 class MyHeap : public Heap {
  public:
-  MyHeap(System* system, unsigned limit) : c(system, limit)
+  MyHeap(System* system, size_t limit, unsigned collectorCount UNUSED)
+      : c(system, limit)
   {
+#ifdef USE_ATOMIC_OPERATIONS
+    if (collectorCount > 1) {
+      startCollectors(&c, collectorCount);
+    }
+#endif
   }
 
   virtual void setClient(Heap::Client* client)
@@ -1948,12 +3257,12 @@ class MyHeap : public Heap {
     c.immortalHeapEnd = start + sizeInWords;
   }
 
-  virtual unsigned remaining()
+  virtual size_t remaining()
   {
     return c.limit - c.count;
   }
 
-  virtual unsigned limit()
+  virtual size_t limit()
   {
     return c.limit;
   }
@@ -2037,13 +3346,9 @@ class MyHeap : public Heap {
     }
   }
 
-  bool targetNeedsMark(void* target)
+  virtual CardTable* cardTable()
   {
-    return target and not c.gen2.contains(target)
-           and not c.nextGen2.contains(target)
-           and not immortalHeapContains(&c, target)
-           and not(c.client->isFixed(target)
-                   and fixie(target)->age >= FixieTenureThreshold);
+    return &(c.cardTable);
   }
 
   virtual void mark(void* p, unsigned offset, unsigned count)
@@ -2060,7 +3365,7 @@ class MyHeap : public Heap {
         bool dirty = false;
         for (unsigned i = 0; i < count; ++i) {
           void** target = static_cast<void**>(p) + offset + i;
-          if (targetNeedsMark(maskAlignedPointer(*target))) {
+          if (targetNeedsMark(&c, maskAlignedPointer(*target))) {
             if (DebugFixies) {
               fprintf(stderr,
                       "dirty fixie %p at %d (%p): %p\n",
@@ -2083,23 +3388,12 @@ class MyHeap : public Heap {
         if (dirty)
           markDirty(&c, f);
       } else {
-        Segment::Map* map;
-        if (c.gen2.contains(p)) {
-          map = &(c.heapMap);
-        } else {
-          assertT(&c, c.nextGen2.contains(p));
-          map = &(c.nextHeapMap);
-        }
-
-        for (unsigned i = 0; i < count; ++i) {
-          void** target = static_cast<void**>(p) + offset + i;
-          if (targetNeedsMark(maskAlignedPointer(*target))) {
-#ifdef USE_ATOMIC_OPERATIONS
-            map->markAtomic(target);
-#else
-            map->set(target);
-#endif
-          }
+        // stores into objects outside the card table during a major
+        // collection are to obsolete copies and may be ignored:
+        uintptr_t i = (reinterpret_cast<uintptr_t>(p) - c.cardTable.start)
+                      >> LogCardSizeInBytes;
+        if (i < c.cardTable.count) {
+          c.cardTable.cards[i] = 1;
         }
       }
     }
@@ -2142,6 +3436,12 @@ class MyHeap : public Heap {
 
   virtual void postVisit()
   {
+#ifdef USE_ATOMIC_OPERATIONS
+    if (c.gatheringRoots) {
+      collectInParallel(&c);
+    }
+#endif
+
     killFixies(&c);
   }
 
@@ -2159,6 +3459,10 @@ class MyHeap : public Heap {
                                             : Tenured);
     } else if (c.nextGen1.contains(p)) {
       return Reachable;
+    } else if (c.markGen2InPlace and c.gen2.contains(p)) {
+      return (fresh(&c, p) or getBit(c.liveMap, c.gen2.indexOf(p)))
+                 ? Tenured
+                 : Unreachable;
     } else if (c.nextGen2.contains(p) or immortalHeapContains(&c, p)
                or (c.gen2.contains(p)
                    and (c.mode == Heap::MinorCollection
@@ -2183,6 +3487,12 @@ class MyHeap : public Heap {
 
   virtual void dispose()
   {
+#ifdef USE_ATOMIC_OPERATIONS
+    if (c.collectorCount > 1) {
+      stopCollectors(&c);
+    }
+#endif
+
     c.dispose();
     assertT(&c, c.count == 0);
     c.system->free(this);
@@ -2197,10 +3507,10 @@ class MyHeap : public Heap {
 
 namespace vm {
 
-Heap* makeHeap(System* system, unsigned limit)
+Heap* makeHeap(System* system, size_t limit, unsigned collectorCount)
 {
   return new (system->tryAllocate(sizeof(local::MyHeap)))
-      local::MyHeap(system, limit);
+      local::MyHeap(system, limit, collectorCount);
 }
 
 }  // namespace vm
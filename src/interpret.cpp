@@ -3319,6 +3319,11 @@ class MyProcessor : public Processor {
     // ignore
   }
 
+  virtual void methodOverridden(vm::Thread*, GcMethod* method)
+  {
+    method->vmFlags() |= OverriddenFlag;
+  }
+
   virtual void visitObjects(vm::Thread* vmt, Heap::Visitor* v)
   {
     Thread* t = static_cast<Thread*>(vmt);
@@ -3282,7 +3282,7 @@ struct JavaVMInitArgs {
   jboolean ignoreUnrecognized;
 };
 
-int parseSize(const char* s)
+int64_t parseSize(const char* s)
 {
   unsigned length = strlen(s);
   RUNTIME_ARRAY(char, buffer, length + 1);
@@ -3294,22 +3294,22 @@ int parseSize(const char* s)
   if (suffix== 'k' or suffix == 'K') {
     memcpy(RUNTIME_ARRAY_BODY(buffer), s, length - 1);
     RUNTIME_ARRAY_BODY(buffer)[length - 1] = 0;
-    return atoi(RUNTIME_ARRAY_BODY(buffer)) * 1024;
+    return strtoll(RUNTIME_ARRAY_BODY(buffer), 0, 10) * 1024;
   }
 
   if (suffix == 'm' or suffix == 'M') {
     memcpy(RUNTIME_ARRAY_BODY(buffer), s, length - 1);
     RUNTIME_ARRAY_BODY(buffer)[length - 1] = 0;
-    return atoi(RUNTIME_ARRAY_BODY(buffer)) * 1024 * 1024;
+    return strtoll(RUNTIME_ARRAY_BODY(buffer), 0, 10) * 1024 * 1024;
   }
 
   if (suffix == 'g' or suffix == 'G') {
     memcpy(RUNTIME_ARRAY_BODY(buffer), s, length - 1);
     RUNTIME_ARRAY_BODY(buffer)[length - 1] = 0;
-    return atoi(RUNTIME_ARRAY_BODY(buffer)) * 1024 * 1024 * 1024;
+    return strtoll(RUNTIME_ARRAY_BODY(buffer), 0, 10) * 1024 * 1024 * 1024;
   }
 
-  return atoi(s);
+  return strtoll(s, 0, 10);
 }
 
 void append(char** p, const char* value, unsigned length, char tail)
@@ -3612,8 +3612,9 @@ extern "C" AVIAN_EXPORT jint JNICALL
 {
   local::JavaVMInitArgs* a = static_cast<local::JavaVMInitArgs*>(args);
 
-  unsigned heapLimit = 0;
+  size_t heapLimit = 0;
   unsigned stackLimit = 0;
+  unsigned gcThreads = 1;
   const char* bootLibraries = 0;
   const char* classpath = 0;
   const char* javaHome = AVIAN_JAVA_HOME;
@@ -3630,7 +3631,12 @@ extern "C" AVIAN_EXPORT jint JNICALL
     if (strncmp(a->options[i].optionString, "-X", 2) == 0) {
       const char* p = a->options[i].optionString + 2;
       if (strncmp(p, "mx", 2) == 0) {
-        heapLimit = local::parseSize(p + 2);
+        int64_t size = local::parseSize(p + 2);
+        heapLimit = size;
+        if (static_cast<int64_t>(heapLimit) != size) {
+          // more than we can address; use as much as we can get
+          heapLimit = ~static_cast<size_t>(0);
+        }
       } else if (strncmp(p, "ss", 2) == 0) {
         stackLimit = local::parseSize(p + 2);
       } else if (strncmp(p,
@@ -3671,6 +3677,11 @@ extern "C" AVIAN_EXPORT jint JNICALL
       } else if (strncmp(p, REENTRANT_PROPERTY "=", sizeof(REENTRANT_PROPERTY))
                  == 0) {
         reentrant = strcmp(p + sizeof(REENTRANT_PROPERTY), "true") == 0;
+      } else if (strncmp(p,
+                         GC_THREADS_PROPERTY "=",
+                         sizeof(GC_THREADS_PROPERTY)) == 0) {
+        int n = atoi(p + sizeof(GC_THREADS_PROPERTY));
+        gcThreads = n > 1 ? n : 1;
       } else if (strncmp(p,
                          EMBED_PREFIX_PROPERTY "=",
                          sizeof(EMBED_PREFIX_PROPERTY)) == 0) {
@@ -3694,7 +3705,7 @@ extern "C" AVIAN_EXPORT jint JNICALL
   }
 
   System* s = makeSystem(reentrant);
-  Heap* h = makeHeap(s, heapLimit);
+  Heap* h = makeHeap(s, heapLimit, gcThreads);
   Classpath* c = makeClasspath(s, h, javaHome, embedPrefix);
 
   if (bootClasspath == 0) {
@@ -34,15 +34,6 @@ const bool DebugClassReader = false;
 
 const unsigned NoByte = 0xFFFF;
 
-#ifdef USE_ATOMIC_OPERATIONS
-void atomicIncrement(uint32_t* p, int v)
-{
-  for (uint32_t old = *p; not atomicCompareAndSwap32(p, old, old + v);
-       old = *p) {
-  }
-}
-#endif
-
 void join(Thread* t, Thread* o)
 {
   if (t != o) {
@@ -168,6 +159,28 @@ void disposeNoRemove(Thread* m, Thread* o)
   dispose(m, o, false);
 }
 
+// returns true if any thread in the tree rooted at o other than t is
+// active, asking each such thread to stop at its next safe point (see
+// compileSafePoint in compile.cpp)
+bool requestSafePoints(Thread* t, Thread* o)
+{
+  bool active = false;
+  if (o != t and o->state == Thread::ActiveState) {
+    o->setFlag(Thread::SafePointFlag);
+    active = true;
+  }
+
+  // walk peers iteratively, as visitAll does, so the recursion depth
+  // is bounded by the depth of the tree rather than the thread count:
+  for (Thread* p = o->child; p; p = p->peer) {
+    if (requestSafePoints(t, p)) {
+      active = true;
+    }
+  }
+
+  return active;
+}
+
 void interruptDaemon(Thread* m, Thread* o)
 {
   if (o->getFlags() & Thread::DaemonFlag) {
@@ -486,6 +499,52 @@ void clearTargetIfFinalizable(Thread* t, GcJreference* r)
   }
 }
 
+ThinLock* makeThinLocks(Heap* heap, unsigned capacity)
+{
+  ThinLock* locks
+      = static_cast<ThinLock*>(heap->allocate(capacity * sizeof(ThinLock)));
+  memset(locks, 0, capacity * sizeof(ThinLock));
+  return locks;
+}
+
+void insertThinLock(ThinLock* locks, uintptr_t mask, ThinLock* l)
+{
+  for (uintptr_t i = thinLockHash(l->target);; ++i) {
+    ThinLock* e = locks + (i & mask);
+    if (e->target == 0) {
+      *e = *l;
+      return;
+    }
+  }
+}
+
+void visitThinLocks(Thread* t, Heap::Visitor* v)
+{
+  Machine* m = t->m;
+  uintptr_t mask = m->thinLocks.mask;
+  ThinLock* locks = m->spareThinLocks;
+
+  memset(locks, 0, (mask + 1) * sizeof(ThinLock));
+
+  for (uintptr_t i = 0; i <= mask; ++i) {
+    ThinLock* l = m->thinLocks.locks + i;
+    if (l->owner and m->heap->status(l->target) != Heap::Unreachable) {
+      v->visit(&(l->target));
+
+      if (l->owner & InflatedLockMark) {
+        object monitor = reinterpret_cast<object>(l->owner & ~InflatedLockMark);
+        v->visit(&monitor);
+        l->owner = reinterpret_cast<uintptr_t>(monitor) | InflatedLockMark;
+      }
+
+      insertThinLock(locks, mask, l);
+    }
+  }
+
+  m->spareThinLocks = m->thinLocks.locks;
+  m->thinLocks.locks = locks;
+}
+
 void postVisit(Thread* t, Heap::Visitor* v)
 {
   Machine* m = t->m;
@@ -661,6 +720,8 @@ void postVisit(Thread* t, Heap::Visitor* v)
       }
     }
   }
+
+  visitThinLocks(t, v);
 }
 
 void postCollect(Thread* t)
@@ -2585,9 +2646,15 @@ void parseMethodTable(Thread* t, Stream& s, GcClass* class_, GcSingleton* pool)
             = hashMapFindNode(t, virtualMap, method, methodHash, methodEqual);
 
         if (p) {
-          method->offset() = cast<GcMethod>(t, p->first())->offset();
+          GcMethod* overridden = cast<GcMethod>(t, p->first());
+          method->offset() = overridden->offset();
 
           p->setSecond(t, method);
+
+          if ((class_->flags() & ACC_INTERFACE) == 0
+              and (overridden->vmFlags() & OverriddenFlag) == 0) {
+            t->m->processor->methodOverridden(t, overridden);
+          }
         } else {
           method->offset() = virtualCount++;
 
@@ -3115,21 +3182,6 @@ GcClass* resolveArrayClass(Thread* t,
   }
 }
 
-void removeMonitor(Thread* t, object o)
-{
-  unsigned hash;
-  if (DebugMonitors) {
-    hash = objectHash(t, o);
-  }
-
-  object m
-      = hashMapRemove(t, roots(t)->monitorMap(), o, objectHash, objectEqual);
-
-  if (DebugMonitors) {
-    fprintf(stderr, "dispose monitor %p for object %x\n", m, hash);
-  }
-}
-
 void removeString(Thread* t, object o)
 {
   hashMapRemove(t, roots(t)->stringMap(), o, stringHash, objectEqual);
@@ -3445,42 +3497,49 @@ class HeapClient : public Heap::Client {
     return n;
   }
 
-  virtual unsigned copiedSizeInWords(void* p)
+  virtual unsigned copiedSizeInWords(void* p, uintptr_t header)
   {
     Thread* t = m->rootThread;
 
-    object o = static_cast<object>(m->heap->follow(maskAlignedPointer(p)));
-    assertT(t, not objectFixed(t, o));
+    object o = static_cast<object>(p);
+    uintptr_t mark = header & (~PointerMask);
+    assertT(t, mark != FixedMark);
 
-    unsigned n = baseSize(t, o, m->heap->follow(objectClass(t, o)));
+    GcClass* class_
+        = m->heap->follow(reinterpret_cast<GcClass*>(header & PointerMask));
 
-    if (objectExtended(t, o) or hashTaken(t, o)) {
+    unsigned n = baseSize(t, o, class_);
+
+    if (mark == ExtendedMark or mark == HashTakenMark) {
       ++n;
     }
 
     return n;
   }
 
-  virtual void copy(void* srcp, void* dstp)
+  virtual void copy(void* srcp, void* dstp, uintptr_t header)
   {
     Thread* t = m->rootThread;
 
-    object src = static_cast<object>(m->heap->follow(maskAlignedPointer(srcp)));
-    assertT(t, not objectFixed(t, src));
+    object src = static_cast<object>(srcp);
+    uintptr_t mark = header & (~PointerMask);
+    assertT(t, mark != FixedMark);
 
-    GcClass* class_ = m->heap->follow(objectClass(t, src));
+    GcClass* class_
+        = m->heap->follow(reinterpret_cast<GcClass*>(header & PointerMask));
 
     unsigned base = baseSize(t, src, class_);
-    unsigned n = extendedSize(t, src, base);
+    unsigned n = base + (mark == ExtendedMark);
 
     object dst = static_cast<object>(dstp);
 
     memcpy(dst, src, n * BytesPerWord);
 
-    if (hashTaken(t, src)) {
-      alias(dst, 0) &= PointerMask;
-      alias(dst, 0) |= ExtendedMark;
+    if (mark == HashTakenMark) {
+      alias(dst, 0) = (header & PointerMask) | ExtendedMark;
       extendedWord(t, dst, base) = takeHash(t, src);
+    } else {
+      alias(dst, 0) = header;
     }
   }
 
@@ -3514,6 +3573,16 @@ void doCollect(Thread* t, Heap::CollectionType type, int pendingAllocation)
 
   Machine* m = t->m;
 
+  // the interface dispatch cache is keyed by address, so its entries
+  // won't survive objects moving, and it shouldn't keep the classes
+  // they refer to reachable anyway (see findInterfaceVtable):
+  if (m->roots and m->roots->interfaceDispatchCache()) {
+    GcArray* cache = m->roots->interfaceDispatchCache();
+    for (unsigned i = 0; i < cache->length(); ++i) {
+      cache->setBodyElement(t, i, 0);
+    }
+  }
+
   m->unsafe = true;
   m->heap->collect(
       type,
@@ -3690,6 +3759,7 @@ Machine::Machine(System* system,
       system(system),
       heapClient(new (heap->allocate(sizeof(HeapClient))) HeapClient(this)),
       heap(heap),
+      cardTable(heap->cardTable()),
       bootFinder(bootFinder),
       appFinder(appFinder),
       processor(processor),
@@ -3702,7 +3772,6 @@ Machine::Machine(System* system,
       arguments(arguments),
       argumentCount(argumentCount),
       threadCount(0),
-      activeCount(0),
       liveCount(0),
       daemonCount(0),
       fixedFootprint(0),
@@ -3723,6 +3792,7 @@ Machine::Machine(System* system,
       finalizeQueue(0),
       weakReferences(0),
       tenuredWeakReferences(0),
+      spareThinLocks(makeThinLocks(heap, InitialThinLockCapacity)),
       unsafe(false),
       collecting(false),
       triedBuiltinOnLoad(false),
@@ -3732,6 +3802,9 @@ Machine::Machine(System* system,
 {
   heap->setClient(heapClient);
 
+  thinLocks.locks = makeThinLocks(heap, InitialThinLockCapacity);
+  thinLocks.mask = InitialThinLockCapacity - 1;
+
   populateJNITables(&javaVMVTable, &jniEnvVTable);
 
   // Copying the properties memory (to avoid memory crashes)
@@ -3807,6 +3880,9 @@ void Machine::dispose()
     heap->free(bootimage, bootimageSize);
   }
 
+  heap->free(thinLocks.locks, (thinLocks.mask + 1) * sizeof(ThinLock));
+  heap->free(spareThinLocks, (thinLocks.mask + 1) * sizeof(ThinLock));
+
   heap->free(arguments, sizeof(const char*) * argumentCount);
 
   for (unsigned int i = 0; i < propertyCount; i++) {
@@ -3915,10 +3991,6 @@ void Thread::init()
     // sequence point, for gc (don't recombine statements)
     roots(this)->setByteArrayMap(this, map->as<GcHashMap>(this));
 
-    map = makeWeakHashMap(this, 0, 0);
-    // sequence point, for gc (don't recombine statements)
-    roots(this)->setMonitorMap(this, map->as<GcHashMap>(this));
-
     GcVector* v = makeVector(this, 0, 0);
     // sequence point, for gc (don't recombine statements)
     roots(this)->setClassRuntimeDataTable(this, v);
@@ -4051,11 +4123,9 @@ void enter(Thread* t, Thread::State s)
   }
 
 #ifdef USE_ATOMIC_OPERATIONS
-#define INCREMENT atomicIncrement
 #define ACQUIRE_LOCK ACQUIRE_RAW(t, t->m->stateLock)
 #define STORE_LOAD_MEMORY_BARRIER storeLoadMemoryBarrier()
 #else
-#define INCREMENT(pointer, value) *(pointer) += value;
 #define ACQUIRE_LOCK
 #define STORE_LOAD_MEMORY_BARRIER
 
@@ -4074,12 +4144,9 @@ void enter(Thread* t, Thread::State s)
 
     switch (t->state) {
     case Thread::ActiveState:
+    case Thread::IdleState:
       break;
 
-    case Thread::IdleState: {
-      INCREMENT(&(t->m->activeCount), 1);
-    } break;
-
     default:
       abort(t);
     }
@@ -4089,7 +4156,10 @@ void enter(Thread* t, Thread::State s)
 
     STORE_LOAD_MEMORY_BARRIER;
 
-    while (t->m->activeCount > 1) {
+    // each thread publishes its own state and checks exclusive after
+    // becoming active, so once we see no other active threads, none
+    // will become active until we leave this state:
+    while (requestSafePoints(t, t->m->rootThread)) {
       t->m->stateLock->wait(t->systemThread, 0);
     }
   } break;
@@ -4097,9 +4167,6 @@ void enter(Thread* t, Thread::State s)
   case Thread::IdleState:
     if (LIKELY(t->state == Thread::ActiveState)) {
       // fast path
-      assertT(t, t->m->activeCount > 0);
-      INCREMENT(&(t->m->activeCount), -1);
-
       t->state = s;
 
       STORE_LOAD_MEMORY_BARRIER;
@@ -4132,9 +4199,6 @@ void enter(Thread* t, Thread::State s)
       abort(t);
     }
 
-    assertT(t, t->m->activeCount > 0);
-    INCREMENT(&(t->m->activeCount), -1);
-
     if (s == Thread::ZombieState) {
       assertT(t, t->m->liveCount > 0);
       --t->m->liveCount;
@@ -4152,8 +4216,6 @@ void enter(Thread* t, Thread::State s)
   case Thread::ActiveState:
     if (LIKELY(t->state == Thread::IdleState and t->m->exclusive == 0)) {
       // fast path
-      INCREMENT(&(t->m->activeCount), 1);
-
       t->state = s;
 
       STORE_LOAD_MEMORY_BARRIER;
@@ -4186,7 +4248,6 @@ void enter(Thread* t, Thread::State s)
           t->m->stateLock->wait(t->systemThread, 0);
         }
 
-        INCREMENT(&(t->m->activeCount), 1);
         if (t->state == Thread::NoState) {
           ++t->m->liveCount;
           ++t->m->threadCount;
@@ -4218,9 +4279,6 @@ void enter(Thread* t, Thread::State s)
       abort(t);
     }
 
-    assertT(t, t->m->activeCount > 0);
-    INCREMENT(&(t->m->activeCount), -1);
-
     t->state = s;
 
     while (t->m->liveCount - t->m->daemonCount > 1) {
@@ -5324,6 +5382,64 @@ object makeObjectArray(Thread* t, GcClass* elementClass, unsigned count)
   return array;
 }
 
+static bool compatibleArrayTypes(Thread* t UNUSED, GcClass* a, GcClass* b)
+{
+  return a->arrayElementSize() and b->arrayElementSize()
+         and (a == b or (not((a->vmFlags() & PrimitiveFlag)
+                             or (b->vmFlags() & PrimitiveFlag))));
+}
+
+void arrayCopy(Thread* t,
+               object src,
+               int32_t srcOffset,
+               object dst,
+               int32_t dstOffset,
+               int32_t length)
+{
+  if (LIKELY(src and dst)) {
+    if (LIKELY(compatibleArrayTypes(
+            t, objectClass(t, src), objectClass(t, dst)))) {
+      unsigned elementSize = objectClass(t, src)->arrayElementSize();
+
+      if (LIKELY(elementSize)) {
+        intptr_t sl = fieldAtOffset<uintptr_t>(src, BytesPerWord);
+        intptr_t dl = fieldAtOffset<uintptr_t>(dst, BytesPerWord);
+        if (LIKELY(length > 0)) {
+          if (LIKELY(srcOffset >= 0 and srcOffset + length <= sl
+                     and dstOffset >= 0 and dstOffset + length <= dl)) {
+            uint8_t* sbody = &fieldAtOffset<uint8_t>(src, ArrayBody);
+            uint8_t* dbody = &fieldAtOffset<uint8_t>(dst, ArrayBody);
+            if (src == dst) {
+              memmove(dbody + (dstOffset * elementSize),
+                      sbody + (srcOffset * elementSize),
+                      length * elementSize);
+            } else {
+              memcpy(dbody + (dstOffset * elementSize),
+                     sbody + (srcOffset * elementSize),
+                     length * elementSize);
+            }
+
+            if (objectClass(t, dst)->objectMask()) {
+              mark(t, dst, ArrayBody + (dstOffset * BytesPerWord), length);
+            }
+
+            return;
+          } else {
+            throwNew(t, GcIndexOutOfBoundsException::Type);
+          }
+        } else {
+          return;
+        }
+      }
+    }
+  } else {
+    throwNew(t, GcNullPointerException::Type);
+    return;
+  }
+
+  throwNew(t, GcArrayStoreException::Type);
+}
+
 static GcByteArray* getFieldName(Thread* t, object obj)
 {
   return reinterpret_cast<GcByteArray*>(cast<GcField>(t, obj)->name());
@@ -5443,48 +5559,81 @@ GcMonitor* objectMonitor(Thread* t, object o, bool createNew)
 {
   assertT(t, t->state == Thread::ActiveState);
 
-  object m = hashMapFind(t, roots(t)->monitorMap(), o, objectHash, objectEqual);
+  ThinLock* l = findThinLock(t, o, false);
 
-  if (m) {
-    if (DebugMonitors) {
-      fprintf(stderr, "found monitor %p for object %x\n", m, objectHash(t, o));
-    }
-
-    return cast<GcMonitor>(t, m);
+  if (l and (l->owner & InflatedLockMark)) {
+    return inflatedMonitor(t, l);
   } else if (createNew) {
     PROTECT(t, o);
+
+    object head = makeMonitorNode(t, 0, 0);
+    GcMonitor* m = makeMonitor(t, 0, 0, 0, head, head, 0);
     PROTECT(t, m);
 
-    {
-      ENTER(t, Thread::ExclusiveState);
+    while (true) {
+      uintptr_t mask = t->m->thinLocks.mask;
+      l = findThinLock(t, o, true);
 
-      m = hashMapFind(t, roots(t)->monitorMap(), o, objectHash, objectEqual);
+      if (l == 0) {
+        growThinLocks(t, mask);
+        continue;
+      }
 
-      if (m) {
+      uintptr_t owner = l->owner;
+      if (owner & InflatedLockMark) {
+        return inflatedMonitor(t, l);
+      }
+
+      // if another thread holds the thin lock, it becomes the owner of
+      // the monitor and adopts it the next time it uses the lock (see
+      // inflatedMonitor):
+      m->owner() = reinterpret_cast<void*>(owner);
+      m->depth() = owner == reinterpret_cast<uintptr_t>(t) ? l->depth + 1 : 0;
+
+      if (atomicCompareAndSwap(&l->owner,
+                               owner,
+                               reinterpret_cast<uintptr_t>(m)
+                               | InflatedLockMark)) {
         if (DebugMonitors) {
           fprintf(
-              stderr, "found monitor %p for object %x\n", m, objectHash(t, o));
+              stderr, "made monitor %p for object %x\n", m, objectHash(t, o));
         }
 
-        return cast<GcMonitor>(t, m);
+        return m;
       }
+    }
+  } else {
+    return 0;
+  }
+}
 
-      object head = makeMonitorNode(t, 0, 0);
-      m = makeMonitor(t, 0, 0, 0, head, head, 0);
+void growThinLocks(Thread* t, uintptr_t mask)
+{
+  ENTER(t, Thread::ExclusiveState);
 
-      if (DebugMonitors) {
-        fprintf(stderr, "made monitor %p for object %x\n", m, objectHash(t, o));
-      }
+  Machine* m = t->m;
+  if (m->thinLocks.mask != mask) {
+    // another thread has already grown the table
+    return;
+  }
 
-      hashMapInsert(t, roots(t)->monitorMap(), o, m, objectHash);
+  uintptr_t capacity = mask + 1;
+  uintptr_t newMask = (capacity * 2) - 1;
+  ThinLock* locks = makeThinLocks(m->heap, newMask + 1);
 
-      addFinalizer(t, o, removeMonitor);
+  for (uintptr_t i = 0; i <= mask; ++i) {
+    ThinLock* l = m->thinLocks.locks + i;
+    if (l->owner) {
+      insertThinLock(locks, newMask, l);
     }
-
-    return cast<GcMonitor>(t, m);
-  } else {
-    return 0;
   }
+
+  m->heap->free(m->thinLocks.locks, capacity * sizeof(ThinLock));
+  m->heap->free(m->spareThinLocks, capacity * sizeof(ThinLock));
+
+  m->thinLocks.locks = locks;
+  m->thinLocks.mask = newMask;
+  m->spareThinLocks = makeThinLocks(m->heap, newMask + 1);
 }
 
 object intern(Thread* t, object s)
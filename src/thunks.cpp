@@ -1,6 +1,7 @@
 THUNK(tryInitClass)
 THUNK(findInterfaceMethodFromInstance)
 THUNK(findInterfaceMethodFromInstanceAndReference)
+THUNK(findInterfaceMethodFromInstanceAndCache)
 THUNK(findSpecialMethodFromReference)
 THUNK(findStaticMethodFromReference)
 THUNK(findVirtualMethodFromReference)
@@ -17,6 +18,12 @@ THUNK(divideDouble)
 THUNK(moduloDouble)
 THUNK(negateDouble)
 THUNK(squareRootDouble)
+THUNK(sineDouble)
+THUNK(cosineDouble)
+THUNK(tangentDouble)
+THUNK(exponentDouble)
+THUNK(logarithmDouble)
+THUNK(powerDouble)
 THUNK(doubleToFloat)
 THUNK(doubleToInt)
 THUNK(doubleToLong)
@@ -44,7 +51,7 @@ THUNK(makeBlankObjectArray)
 THUNK(makeBlankObjectArrayFromReference)
 THUNK(makeBlankArray)
 THUNK(lookUpAddress)
-THUNK(setMaybeNull)
+THUNK(markFixed)
 THUNK(acquireMonitorForObject)
 THUNK(acquireMonitorForObjectOnEntrance)
 THUNK(releaseMonitorForObject)
@@ -52,9 +59,11 @@ THUNK(acquireMonitorForClassOnEntrance)
 THUNK(releaseMonitorForClass)
 THUNK(makeMultidimensionalArray)
 THUNK(makeMultidimensionalArrayFromReference)
+THUNK(copyArray)
 THUNK(throw_)
 THUNK(checkCast)
 THUNK(checkCastFromReference)
+THUNK(checkCastAndCache)
 THUNK(getStaticFieldValueFromReference)
 THUNK(getFieldValueFromReference)
 THUNK(setStaticFieldValueFromReference)
@@ -65,6 +74,7 @@ THUNK(setStaticObjectFieldValueFromReference)
 THUNK(setObjectFieldValueFromReference)
 THUNK(instanceOf64)
 THUNK(instanceOfFromReference)
+THUNK(instanceOfAndCache)
 THUNK(makeNewGeneral64)
 THUNK(makeNew64)
 THUNK(makeNewFromReference)
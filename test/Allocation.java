@@ -0,0 +1,128 @@
+public class Allocation {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  // big enough that a thread-local heap (64KB) holds only a few:
+  private static class Node {
+    Node next;
+    int value;
+    long a, b, c, d, e, f, g, h;
+  }
+
+  private static class Empty { }
+
+  // Allocates enough objects that the thread-local heap fills many
+  // times over, keeping every tenth one reachable, and checks that
+  // each is initialized correctly whether it came from the inline fast
+  // path or the thunk.
+  private static void objects(int count) {
+    Node head = null;
+    for (int i = 0; i < count; ++i) {
+      Node n = new Node();
+      expect(n.next == null && n.value == 0 && n.a == 0 && n.h == 0);
+      expect(n.getClass() == Node.class);
+      n.value = i;
+      n.h = i;
+      if (i % 10 == 0) {
+        n.next = head;
+        head = n;
+      }
+
+      Empty e = new Empty();
+      expect(e.getClass() == Empty.class);
+    }
+
+    int expected = ((count - 1) / 10) * 10;
+    for (Node n = head; n != null; n = n.next) {
+      expect(n.value == expected && n.h == expected);
+      expected -= 10;
+    }
+    expect(expected == -10);
+  }
+
+  private static void arrays(int length) {
+    boolean[] z = new boolean[length];
+    byte[] b = new byte[length];
+    char[] c = new char[length];
+    short[] s = new short[length];
+    int[] i = new int[length];
+    float[] f = new float[length];
+    long[] j = new long[length];
+    double[] d = new double[length];
+    Object[] o = new Object[length];
+    String[] t = new String[length];
+
+    expect(z.length == length && b.length == length && c.length == length
+           && s.length == length && i.length == length && f.length == length
+           && j.length == length && d.length == length && o.length == length
+           && t.length == length);
+
+    expect(z.getClass() == boolean[].class && o.getClass() == Object[].class
+           && t.getClass() == String[].class);
+
+    for (int k = 0; k < length; ++k) {
+      expect(! z[k] && b[k] == 0 && c[k] == 0 && s[k] == 0 && i[k] == 0
+             && f[k] == 0 && j[k] == 0 && d[k] == 0 && o[k] == null
+             && t[k] == null);
+    }
+
+    if (length > 0) {
+      j[length - 1] = -1;
+      o[length - 1] = o;
+      expect(j[length - 1] == -1 && o[length - 1] == o);
+    }
+  }
+
+  private static void expectNegativeArraySize(int length) {
+    try {
+      int[] a = new int[length];
+      expect(false);
+    } catch (NegativeArraySizeException e) { }
+
+    try {
+      Object[] a = new Object[length];
+      expect(false);
+    } catch (NegativeArraySizeException e) { }
+  }
+
+  public static void main(String[] args) throws Exception {
+    objects(100000);
+
+    // lengths around those which fit in what's left of the thread-local
+    // heap, in an empty one, and not at all:
+    int[] lengths = new int[] { 0, 1, 2, 7, 8, 9, 100, 1000, 1023, 1024,
+                                1025, 8191, 8192, 8193, 16 * 1024,
+                                64 * 1024, 100 * 1024 };
+    for (int round = 0; round < 4; ++round) {
+      for (int k = 0; k < lengths.length; ++k) {
+        arrays(lengths[k]);
+      }
+    }
+
+    expectNegativeArraySize(-1);
+    expectNegativeArraySize(Integer.MIN_VALUE);
+
+    { Thread[] threads = new Thread[4];
+      final boolean[] success = new boolean[threads.length];
+      for (int k = 0; k < threads.length; ++k) {
+        final int index = k;
+        threads[k] = new Thread() {
+            public void run() {
+              objects(50000);
+              for (int length = 0; length < 5000; length += 97) {
+                arrays(length);
+              }
+              success[index] = true;
+            }
+          };
+        threads[k].start();
+      }
+
+      for (int k = 0; k < threads.length; ++k) {
+        threads[k].join();
+        expect(success[k]);
+      }
+    }
+  }
+}
@@ -0,0 +1,309 @@
+import avian.Stream;
+import avian.ConstantPool;
+import avian.Assembler;
+import avian.Assembler.FieldData;
+import avian.Assembler.MethodData;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.lang.reflect.InvocationTargetException;
+import java.lang.reflect.Method;
+
+public class BoundsChecks {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  // The JIT omits the bounds checks in loops of this form:
+
+  private static int sum(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; ++i) {
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static void fill(long[] a, long v) {
+    for (int i = 0; i < a.length; ++i) {
+      a[i] = v;
+    }
+  }
+
+  private static void copy(Object[] a, Object[] b) {
+    for (int i = 2; i < a.length; ++i) {
+      b[i - 2] = a[i];
+    }
+  }
+
+  private static int sumHighLocal(int[] a, int p, int q, int r) {
+    int s = p + q + r;
+    for (int i = 0; i < a.length; ++i) {
+      s += a[i];
+    }
+    return s;
+  }
+
+  // ...but not in these, all of which may index out of range:
+
+  private static int sumFrom(int[] a, int start) {
+    int s = 0;
+    for (int i = start; i < a.length; ++i) {
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int sumFromMinusOne(int[] a) {
+    int s = 0;
+    for (int i = -1; i < a.length; ++i) {
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int writesIndex(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; ++i) {
+      if (i == a.length - 1) {
+        ++i;
+      }
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int writesIndexHighLocal(int[] a, int p, int q, int r) {
+    int s = p + q + r;
+    for (int i = 0; i < a.length; ++i) {
+      if (i == a.length - 1) {
+        i = a.length;
+      }
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int reassignsArray(int[] a, int[] b) {
+    int s = 0;
+    for (int i = 0; i < a.length; ++i) {
+      if (i == b.length) {
+        a = b;
+      }
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int strideTwo(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; i += 2) {
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int strideMinusOne(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; --i) {
+      s += a[i];
+    }
+    return s;
+  }
+
+  private static int sumNext(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; ++i) {
+      s += a[i + 1];
+    }
+    return s;
+  }
+
+  private static int sumPrevious(int[] a) {
+    int s = 0;
+    for (int i = 0; i < a.length; ++i) {
+      s += a[i - 1];
+    }
+    return s;
+  }
+
+  // Assembles a method equivalent to sum(a) except that, if start is
+  // negative, it enters the loop body directly with i = start.  javac
+  // will not generate a branch into a loop body, so we do it ourselves:
+  //
+  //   int s = 0; int i = start;
+  //   if (start < 0) goto B;
+  //   i = 0;
+  //   H: if (i >= a.length) goto X;
+  //   B: s += a[i];
+  //   ++i; goto H;
+  //   X: return s;
+  private static byte[] makeEnterBodyCode() throws IOException {
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    Stream.write2(out, 2); // max stack
+    Stream.write2(out, 4); // max locals
+    Stream.write4(out, 0); // length (we'll set the real value later)
+
+    //  0:
+    Stream.write1(out, 0x03); // iconst_0
+    Stream.write1(out, 0x3e); // istore_3
+    Stream.write1(out, 0x1b); // iload_1
+    Stream.write1(out, 0x3d); // istore_2
+    Stream.write1(out, 0x1b); // iload_1
+    //  5:
+    Stream.write1(out, 0x9b); // iflt
+    Stream.write2(out, 16 - 5);
+    //  8:
+    Stream.write1(out, 0x03); // iconst_0
+    Stream.write1(out, 0x3d); // istore_2
+    // 10:
+    Stream.write1(out, 0x1c); // iload_2
+    Stream.write1(out, Assembler.aload_0);
+    Stream.write1(out, 0xbe); // arraylength
+    // 13:
+    Stream.write1(out, 0xa2); // if_icmpge
+    Stream.write2(out, 28 - 13);
+    // 16:
+    Stream.write1(out, 0x1d); // iload_3
+    Stream.write1(out, Assembler.aload_0);
+    Stream.write1(out, 0x1c); // iload_2
+    Stream.write1(out, 0x2e); // iaload
+    Stream.write1(out, 0x60); // iadd
+    Stream.write1(out, 0x3e); // istore_3
+    // 22:
+    Stream.write1(out, 0x84); // iinc
+    Stream.write1(out, 2);
+    Stream.write1(out, 1);
+    // 25:
+    Stream.write1(out, Assembler.goto_);
+    Stream.write2(out, 10 - 25);
+    // 28:
+    Stream.write1(out, 0x1d); // iload_3
+    Stream.write1(out, Assembler.ireturn);
+
+    Stream.write2(out, 0); // exception handler table length
+    Stream.write2(out, 0); // attribute count
+
+    byte[] result = out.toByteArray();
+    Stream.set4(result, 4, result.length - 12);
+
+    return result;
+  }
+
+  private static Method makeEnterBody() throws Exception {
+    List pool = new ArrayList();
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    String name = "$EnterBodyTest$";
+
+    Assembler.writeClass
+      (out, pool, ConstantPool.addClass(pool, name),
+       ConstantPool.addClass(pool, "java/lang/Object"),
+       new int[0], new FieldData[0], new MethodData[]
+       { new MethodData(Assembler.ACC_STATIC | Assembler.ACC_PUBLIC,
+                        ConstantPool.addUtf8(pool, "sum"),
+                        ConstantPool.addUtf8(pool, "([II)I"),
+                        makeEnterBodyCode()) });
+
+    return new MyClassLoader(BoundsChecks.class.getClassLoader())
+      .defineClass(name, out.toByteArray())
+      .getMethod("sum", int[].class, int.class);
+  }
+
+  private static void expectOutOfBounds(Exception e) {
+    expect(e instanceof ArrayIndexOutOfBoundsException
+           || (e instanceof InvocationTargetException
+               && (((InvocationTargetException) e).getCause()
+                   instanceof ArrayIndexOutOfBoundsException)));
+  }
+
+  public static void main(String[] args) throws Exception {
+    int[] a = new int[] { 1, 2, 3, 4, 5 };
+    int[] empty = new int[0];
+
+    expect(sum(a) == 15);
+    expect(sum(empty) == 0);
+
+    { long[] b = new long[7];
+      fill(b, -1L);
+      for (int i = 0; i < b.length; ++i) {
+        expect(b[i] == -1L);
+      }
+    }
+
+    { Object[] b = new Object[] { "a", "b", "c", "d" };
+      Object[] c = new Object[2];
+      copy(b, c);
+      expect(c[0] == "c" && c[1] == "d");
+    }
+
+    expect(sumHighLocal(a, 1, 2, 3) == 21);
+
+    expect(sumFrom(a, 2) == 12);
+    try {
+      sumFrom(a, -1);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    try {
+      sumFromMinusOne(a);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    try {
+      writesIndex(a);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    try {
+      writesIndexHighLocal(a, 1, 2, 3);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    expect(reassignsArray(a, new int[] { 1, 1, 1, 1, 1, 1 }) == 15);
+    try {
+      reassignsArray(a, new int[] { 1, 1 });
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    expect(strideTwo(a) == 9);
+    expect(strideTwo(new int[] { 1, 2, 3, 4 }) == 4);
+
+    try {
+      strideMinusOne(a);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    try {
+      sumNext(a);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    try {
+      sumPrevious(a);
+      expect(false);
+    } catch (ArrayIndexOutOfBoundsException e) { }
+
+    { Method m = makeEnterBody();
+      expect((Integer) m.invoke(null, a, 0) == 15);
+      expect((Integer) m.invoke(null, a, 3) == 15);
+      try {
+        m.invoke(null, a, -1);
+        expect(false);
+      } catch (InvocationTargetException e) {
+        expectOutOfBounds(e);
+      }
+    }
+  }
+
+  private static class MyClassLoader extends ClassLoader {
+    public MyClassLoader(ClassLoader parent) {
+      super(parent);
+    }
+
+    public Class defineClass(String name, byte[] bytes) {
+      return super.defineClass(name, bytes, 0, bytes.length);
+    }
+  }
+}
@@ -0,0 +1,167 @@
+public class Devirtualize {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  // Each Bn below overrides Am and is only loaded when makeBn is
+  // first called, after calls to Am.m have been compiled as direct
+  // calls.
+
+  private static class A1 {
+    int m() { return 1; }
+  }
+
+  private static class B1 extends A1 {
+    int m() { return 2; }
+  }
+
+  private static A1 makeB1() {
+    return new B1();
+  }
+
+  private static int call1(A1 a) {
+    return a.m();
+  }
+
+  private static class A2 {
+    int m() { return 1; }
+  }
+
+  private static class B2 extends A2 {
+    int m() { return 2; }
+  }
+
+  private static A2 makeB2() {
+    return new B2();
+  }
+
+  private static int call2(A2 a, boolean call) {
+    return call ? a.m() : 0;
+  }
+
+  private static class A3 {
+    int m() { return 1; }
+
+    int self() { return m(); }
+  }
+
+  private static class B3 extends A3 {
+    int m() { return 2; }
+  }
+
+  private static A3 makeB3() {
+    return new B3();
+  }
+
+  private static class A4 {
+    int m() { return 1; }
+  }
+
+  private static int call4(A4 a) {
+    return a.m();
+  }
+
+  private static class A5 {
+    int m() { return 1; }
+  }
+
+  private static class B5 extends A5 {
+    int m() { return 2; }
+  }
+
+  private static A5 makeB5() {
+    return new B5();
+  }
+
+  private static volatile boolean spinning;
+  private static volatile boolean done;
+
+  private static int spin(A5 a) {
+    int s = 0;
+    spinning = true;
+    while (! done) {
+      s += a.m();
+    }
+    return s;
+  }
+
+  private static boolean hasFrame(StackTraceElement[] trace, String name) {
+    for (int i = 0; i < trace.length; ++i) {
+      if (trace[i].getMethodName().equals(name)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  public static void main(String[] args) throws Exception {
+    // a call site compiled as a direct call dispatches to the
+    // overriding method once it has been loaded:
+    { A1 a = new A1();
+      expect(call1(a) == 1);
+
+      A1 b = makeB1();
+      expect(call1(b) == 2);
+      expect(call1(a) == 1);
+    }
+
+    // likewise if the override is loaded before the target has been
+    // compiled:
+    { A2 a = new A2();
+      expect(call2(a, false) == 0);
+
+      A2 b = makeB2();
+      expect(call2(b, true) == 2);
+      expect(call2(a, true) == 1);
+    }
+
+    // calls to methods of "this" are invalidated like any other:
+    { A3 a = new A3();
+      expect(a.self() == 1);
+
+      A3 b = makeB3();
+      expect(b.self() == 2);
+      expect(a.self() == 1);
+    }
+
+    // a thread sampled while calling through an invalidated call site
+    // (and thus possibly inside a dispatch stub) has a complete trace:
+    { done = true;
+      expect(spin(new A5()) == 0);
+      done = false;
+      spinning = false;
+
+      final A5 b = makeB5();
+      Thread thread = new Thread() {
+          public void run() {
+            spin(b);
+          }
+        };
+      thread.start();
+
+      while (! spinning) {
+        Thread.yield();
+      }
+
+      for (int i = 0; i < 1000; ++i) {
+        expect(hasFrame(thread.getStackTrace(), "spin"));
+      }
+
+      done = true;
+      thread.join();
+    }
+
+    // a devirtualized call still throws on a null receiver:
+    { A4 a = new A4();
+      expect(call4(a) == 1);
+
+      boolean threw = false;
+      try {
+        call4(null);
+      } catch (NullPointerException e) {
+        threw = true;
+      }
+      expect(threw);
+    }
+  }
+}
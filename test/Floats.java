@@ -347,5 +347,28 @@ public class Floats {
       expect(! (Float.NaN == d));
       expect(d != d);
       expect(! (d == d)); }
+
+    { double zero = 0;
+      double one = 1;
+      expect(Math.sin(zero) == 0);
+      expect(Math.cos(zero) == 1);
+      expect(Math.tan(zero) == 0);
+      expect(Math.exp(zero) == 1);
+      expect(Math.log(one) == 0);
+
+      expect(Math.abs(Math.sin(Math.PI / 2) - 1) < 1e-12);
+      expect(Math.abs(Math.cos(Math.PI) + 1) < 1e-12);
+      expect(Math.abs(Math.tan(Math.PI / 4) - 1) < 1e-12);
+      expect(Math.abs(Math.exp(one) - Math.E) < 1e-12);
+      expect(Math.abs(Math.log(Math.E) - 1) < 1e-12);
+      expect(Double.isNaN(Math.log(-one)));
+
+      // the arguments differ so that swapping them would be noticed:
+      double two = 2;
+      double ten = 10;
+      expect(Math.pow(two, ten) == 1024);
+      expect(Math.pow(ten, two) == 100);
+      expect(Math.pow(two, -one) == 0.5);
+      expect(Math.pow(ten, zero) == 1); }
   }
 }
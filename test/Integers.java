@@ -64,6 +64,18 @@ public class Integers {
     }
   }
 
+  private static int junction(boolean x) {
+    // the sum must not be computed using only the constant which
+    // reaches L2 first
+    int y = (x ? 1 : 2) + 3;
+    return y;
+  }
+
+  private static int junction(int x) {
+    int y = (x < 0 ? -1 : x == 0 ? 0 : 1) * 5 + 7;
+    return y;
+  }
+
   public static void main(String[] args) throws Exception {
     { int foo = 1028;
       foo -= 1023;
@@ -366,5 +378,35 @@ public class Integers {
     expect(291 == Integer.decode("#123").intValue());
 
     testNumberOfLeadingZeros();
+
+    expect(Integer.bitCount(0) == 0);
+    expect(Integer.bitCount(-1) == 32);
+    expect(Integer.bitCount(Integer.MIN_VALUE) == 1);
+    expect(Integer.bitCount(0x0F0F0F0F) == 16);
+
+    expect(Integer.numberOfLeadingZeros(-1) == 0);
+    expect(Integer.numberOfLeadingZeros(Integer.MIN_VALUE) == 0);
+
+    expect(Integer.reverseBytes(0) == 0);
+    expect(Integer.reverseBytes(-1) == -1);
+    expect(Integer.reverseBytes(Integer.MIN_VALUE) == 0x80);
+    expect(Integer.reverseBytes(0x12345678) == 0x78563412);
+
+    { int[] values = { 0, -1, Integer.MIN_VALUE, 0x12345678 };
+      int[] bitCounts = { 0, 32, 1, 13 };
+      int[] leadingZeros = { 32, 0, 0, 3 };
+      int[] reversed = { 0, -1, 0x80, 0x78563412 };
+      for (int i = 0; i < values.length; ++i) {
+        expect(Integer.bitCount(values[i]) == bitCounts[i]);
+        expect(Integer.numberOfLeadingZeros(values[i]) == leadingZeros[i]);
+        expect(Integer.reverseBytes(values[i]) == reversed[i]);
+      }
+    }
+
+    expect(junction(true) == 4);
+    expect(junction(false) == 5);
+    expect(junction(-9) == 2);
+    expect(junction(0) == 7);
+    expect(junction(9) == 12);
   }
 }
@@ -0,0 +1,103 @@
+public class InterfaceCache {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private interface Shape { int sides(); }
+
+  private interface Named { String name(); }
+
+  private static class Triangle implements Shape {
+    public int sides() { return 3; }
+  }
+
+  private static class Square implements Named, Shape {
+    public String name() { return "square"; }
+    public int sides() { return 4; }
+  }
+
+  private static class Pentagon implements Shape, Named {
+    public int sides() { return 5; }
+    public String name() { return "pentagon"; }
+  }
+
+  // inherits its implementation (and its vtable offset) from Square:
+  private static class Rectangle extends Square {
+    public String name() { return "rectangle"; }
+  }
+
+  // overrides it:
+  private static class Hexagon extends Square {
+    public int sides() { return 6; }
+  }
+
+  private static abstract class Polygon implements Shape { }
+
+  private static class Heptagon extends Polygon {
+    public int sides() { return 7; }
+  }
+
+  // All calls in this test go through this one invokeinterface
+  // instruction, whose inline cache holds at most two receiver
+  // classes:
+  private static int sides(Shape s) {
+    return s.sides();
+  }
+
+  private static void expectSides(Shape[] shapes, int[] sides, int rounds) {
+    for (int i = 0; i < rounds; ++i) {
+      for (int j = 0; j < shapes.length; ++j) {
+        expect(sides(shapes[j]) == sides[j]);
+      }
+    }
+  }
+
+  public static void main(String[] args) {
+    Shape triangle = new Triangle();
+    Shape square = new Square();
+    Shape pentagon = new Pentagon();
+    Shape rectangle = new Rectangle();
+    Shape hexagon = new Hexagon();
+    Shape heptagon = new Heptagon();
+
+    // monomorphic:
+    expectSides(new Shape[] { triangle }, new int[] { 3 }, 10);
+
+    // bimorphic, with the second class's method at a different itable
+    // position than the first's:
+    expectSides(new Shape[] { square }, new int[] { 4 }, 10);
+    expectSides(new Shape[] { triangle, square }, new int[] { 3, 4 }, 10);
+
+    // megamorphic, so both cached classes must still hit and every
+    // other class must take the slow path:
+    expectSides
+      (new Shape[] { pentagon, rectangle, hexagon, heptagon },
+       new int[] { 5, 4, 6, 7 }, 10);
+
+    expectSides
+      (new Shape[] { triangle, square, pentagon, rectangle, hexagon,
+                     heptagon },
+       new int[] { 3, 4, 5, 4, 6, 7 }, 10);
+
+    expectSides(new Shape[] { triangle }, new int[] { 3 }, 10);
+    expectSides(new Shape[] { heptagon }, new int[] { 7 }, 10);
+
+    // a null receiver throws whatever state the cache is in:
+    boolean threw = false;
+    try {
+      sides(null);
+    } catch (NullPointerException e) {
+      threw = true;
+    }
+    expect(threw);
+
+    // the same classes through another interface are unaffected:
+    Named[] named = new Named[] { (Named) square, (Named) pentagon,
+                                  (Named) rectangle, (Named) hexagon };
+    String[] names = new String[] { "square", "pentagon", "rectangle",
+                                    "square" };
+    for (int i = 0; i < named.length; ++i) {
+      expect(named[i].name().equals(names[i]));
+    }
+  }
+}
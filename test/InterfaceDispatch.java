@@ -0,0 +1,142 @@
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.util.HashMap;
+import java.util.Map;
+
+public class InterfaceDispatch {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  public interface I1 { int one(); }
+
+  public interface I2 { int two(); }
+
+  public interface I3 { int three(); }
+
+  public interface I4 extends I1 { int four(); }
+
+  public static class A implements I1, I2, I3 {
+    public int one() { return 1; }
+    public int two() { return 2; }
+    public int three() { return 3; }
+  }
+
+  public static class B implements I2, I3, I4 {
+    public int one() { return 11; }
+    public int two() { return 12; }
+    public int three() { return 13; }
+    public int four() { return 14; }
+  }
+
+  public static class C extends B implements I1 {
+    public int one() { return 21; }
+  }
+
+  public static class D extends A implements I4 {
+    public int four() { return 34; }
+  }
+
+  // Loaded once by the system class loader and once by each of several
+  // MyClassLoaders, each of which defines its own copies of the
+  // classes and interfaces above.  Every (class, interface) pair is
+  // thus distinct, and with enough loaders many share a bucket in the
+  // VM's interface dispatch cache.
+  public static class Test {
+    public static int run(int iterations) {
+      Object[] objects = new Object[] { new A(), new B(), new C(), new D() };
+      int sum = 0;
+      for (int i = 0; i < iterations; ++i) {
+        for (int j = 0; j < objects.length; ++j) {
+          Object o = objects[j];
+          if (o instanceof I1) sum += ((I1) o).one();
+          if (o instanceof I2) sum += ((I2) o).two();
+          if (o instanceof I3) sum += ((I3) o).three();
+          if (o instanceof I4) sum += ((I4) o).four();
+        }
+      }
+      return sum;
+    }
+  }
+
+  private static byte[] read(InputStream in) throws IOException {
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    byte[] buffer = new byte[1024];
+    int c;
+    while ((c = in.read(buffer)) > 0) {
+      out.write(buffer, 0, c);
+    }
+    in.close();
+    return out.toByteArray();
+  }
+
+  private static class MyClassLoader extends ClassLoader {
+    private final Map<String, Class> classes = new HashMap<String, Class>();
+
+    public MyClassLoader(ClassLoader parent) {
+      super(parent);
+    }
+
+    protected Class loadClass(String name, boolean resolve)
+      throws ClassNotFoundException
+    {
+      if (! name.startsWith("InterfaceDispatch$")) {
+        return super.loadClass(name, resolve);
+      }
+
+      Class c = classes.get(name);
+      if (c == null) {
+        try {
+          byte[] bytes = read
+            (getParent().getResourceAsStream(name + ".class"));
+          c = defineClass(name, bytes, 0, bytes.length);
+        } catch (IOException e) {
+          throw new ClassNotFoundException(name, e);
+        }
+        classes.put(name, c);
+      }
+      return c;
+    }
+  }
+
+  private static int run(Class c, int iterations) throws Exception {
+    return (Integer) c.getMethod("run", int.class).invoke(null, iterations);
+  }
+
+  public static void main(String[] args) throws Exception {
+    int expected = Test.run(1);
+    expect(expected == (1 + 2 + 3) + (11 + 12 + 13 + 14) + (21 + 12 + 13 + 14)
+           + (1 + 2 + 3 + 34));
+
+    ClassLoader parent = InterfaceDispatch.class.getClassLoader();
+    Class[] tests = new Class[32];
+    for (int i = 0; i < tests.length; ++i) {
+      tests[i] = new MyClassLoader(parent)
+        .loadClass("InterfaceDispatch$Test");
+      expect(tests[i] != Test.class);
+    }
+
+    for (int round = 0; round < 3; ++round) {
+      for (int i = 0; i < tests.length; ++i) {
+        expect(run(tests[i], 10) == expected * 10);
+        expect(Test.run(10) == expected * 10);
+      }
+
+      // the cache is cleared by each collection and refilled after:
+      System.gc();
+    }
+
+    // classes from loaders which are no longer reachable must not
+    // confuse lookups for those which remain:
+    for (int i = 0; i < tests.length; i += 2) {
+      tests[i] = null;
+    }
+    System.gc();
+
+    for (int i = 1; i < tests.length; i += 2) {
+      expect(run(tests[i], 10) == expected * 10);
+    }
+    expect(Test.run(10) == expected * 10);
+  }
+}
@@ -0,0 +1,256 @@
+import avian.Stream;
+import avian.ConstantPool;
+import avian.Assembler;
+import avian.Assembler.FieldData;
+import avian.Assembler.MethodData;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.lang.reflect.InvocationTargetException;
+import java.lang.reflect.Method;
+
+public class Monitors {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class MyException extends RuntimeException { }
+
+  private static void expectAvailable(final Object o) throws Exception {
+    expect(! Thread.holdsLock(o));
+
+    final boolean[] acquired = new boolean[1];
+    Thread thread = new Thread() {
+        public void run() {
+          synchronized (o) {
+            acquired[0] = true;
+          }
+        }
+      };
+    thread.start();
+    thread.join();
+
+    expect(acquired[0]);
+  }
+
+  private static void throwInside(Object o) {
+    synchronized (o) {
+      throw new MyException();
+    }
+  }
+
+  private static int dereferenceInside(Object o, int[] array) {
+    synchronized (o) {
+      return array.length;
+    }
+  }
+
+  private static void throwInsideNested(Object o) {
+    synchronized (o) {
+      try {
+        synchronized (o) {
+          throw new MyException();
+        }
+      } catch (MyException e) {
+        expect(Thread.holdsLock(o));
+      }
+      throw new MyException();
+    }
+  }
+
+  private static void throwAfterWait(Object o) throws InterruptedException {
+    synchronized (o) {
+      o.wait(1);
+      throw new MyException();
+    }
+  }
+
+  private synchronized void throwInsideSynchronizedMethod() {
+    throw new MyException();
+  }
+
+  private static synchronized void throwInsideStaticSynchronizedMethod() {
+    throw new MyException();
+  }
+
+  // Assembles "static void exit(Object o) { monitorexit o; }", which
+  // javac will not generate for us since it's unbalanced.
+  private static byte[] makeExitCode() throws IOException {
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    Stream.write2(out, 1); // max stack
+    Stream.write2(out, 1); // max locals
+    Stream.write4(out, 0); // length (we'll set the real value later)
+
+    Stream.write1(out, Assembler.aload_0);
+    Stream.write1(out, 0xc3); // monitorexit
+    Stream.write1(out, Assembler.return_);
+
+    Stream.write2(out, 0); // exception handler table length
+    Stream.write2(out, 0); // attribute count
+
+    byte[] result = out.toByteArray();
+    Stream.set4(result, 4, result.length - 12);
+
+    return result;
+  }
+
+  private static Method makeExit() throws Exception {
+    List pool = new ArrayList();
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    String name = "$MonitorExitTest$";
+
+    Assembler.writeClass
+      (out, pool, ConstantPool.addClass(pool, name),
+       ConstantPool.addClass(pool, "java/lang/Object"),
+       new int[0], new FieldData[0], new MethodData[]
+       { new MethodData(Assembler.ACC_STATIC | Assembler.ACC_PUBLIC,
+                        ConstantPool.addUtf8(pool, "exit"),
+                        ConstantPool.addUtf8(pool, "(Ljava/lang/Object;)V"),
+                        makeExitCode()) });
+
+    return new MyClassLoader(Monitors.class.getClassLoader())
+      .defineClass(name, out.toByteArray())
+      .getMethod("exit", Object.class);
+  }
+
+  private static void expectIllegalExit(Method exit, Object o)
+    throws Exception
+  {
+    boolean threw = false;
+    try {
+      exit.invoke(null, o);
+    } catch (InvocationTargetException e) {
+      threw = e.getCause() instanceof IllegalMonitorStateException;
+    }
+    expect(threw);
+  }
+
+  public static void main(String[] args) throws Exception {
+    // locks are released when an exception leaves a synchronized
+    // block or method:
+    { Object o = new Object();
+      boolean threw = false;
+      try {
+        throwInside(o);
+      } catch (MyException e) {
+        threw = true;
+      }
+      expect(threw);
+      expectAvailable(o);
+
+      threw = false;
+      try {
+        dereferenceInside(o, null);
+      } catch (NullPointerException e) {
+        threw = true;
+      }
+      expect(threw);
+      expectAvailable(o);
+
+      threw = false;
+      try {
+        throwInsideNested(o);
+      } catch (MyException e) {
+        threw = true;
+      }
+      expect(threw);
+      expectAvailable(o);
+
+      threw = false;
+      try {
+        throwAfterWait(o);
+      } catch (MyException e) {
+        threw = true;
+      }
+      expect(threw);
+      expectAvailable(o);
+
+      Monitors m = new Monitors();
+      threw = false;
+      try {
+        m.throwInsideSynchronizedMethod();
+      } catch (MyException e) {
+        threw = true;
+      }
+      expect(threw);
+      expectAvailable(m);
+
+      threw = false;
+      try {
+        throwInsideStaticSynchronizedMethod();
+      } catch (MyException e) {
+        threw = true;
+      }
+      expect(threw);
+      expectAvailable(Monitors.class);
+    }
+
+    Method exit = makeExit();
+
+    // releasing a lock we don't hold is an error:
+    { Object o = new Object();
+
+      expectIllegalExit(exit, o);
+      expectAvailable(o);
+
+      // likewise once the lock has been inflated:
+      synchronized (o) {
+        o.wait(1);
+      }
+      expectIllegalExit(exit, o);
+      expectAvailable(o);
+    }
+
+    { final Object o = new Object();
+      final Object started = new Object();
+      final boolean[] state = new boolean[2];
+
+      Thread thread = new Thread() {
+          public void run() {
+            synchronized (o) {
+              synchronized (started) {
+                state[0] = true;
+                started.notifyAll();
+                while (! state[1]) {
+                  try {
+                    started.wait();
+                  } catch (InterruptedException e) {
+                    throw new RuntimeException(e);
+                  }
+                }
+              }
+            }
+          }
+        };
+
+      synchronized (started) {
+        thread.start();
+        while (! state[0]) {
+          started.wait();
+        }
+      }
+
+      // another thread holds o, so we can't release it:
+      expectIllegalExit(exit, o);
+
+      synchronized (started) {
+        state[1] = true;
+        started.notifyAll();
+      }
+      thread.join();
+      expectAvailable(o);
+    }
+  }
+
+  private static class MyClassLoader extends ClassLoader {
+    public MyClassLoader(ClassLoader parent) {
+      super(parent);
+    }
+
+    public Class defineClass(String name, byte[] bytes) {
+      return super.defineClass(name, bytes, 0, bytes.length);
+    }
+  }
+}
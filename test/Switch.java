@@ -1,3 +1,15 @@
+import avian.Stream;
+import avian.ConstantPool;
+import avian.Assembler;
+import avian.Assembler.FieldData;
+import avian.Assembler.MethodData;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.lang.reflect.Method;
+
 public class Switch {
   private static int table(int k) {
     switch (k) {
@@ -43,11 +55,195 @@ public class Switch {
     }
   }
 
+  // more than eight cases, so this isn't compiled as a chain of
+  // comparisons:
+  private static int sparse(int k) {
+    switch (k) {
+    case -1000000:
+      return 1;
+    case -1000:
+      return 2;
+    case 0:
+      return 3;
+    case 7:
+      return 4;
+    case 1000:
+      return 5;
+    case 4096:
+      return 6;
+    case 65536:
+      return 7;
+    case 1000000:
+      return 8;
+    case 123456789:
+      return 9;
+    default:
+      return 10;
+    }
+  }
+
+  private static int extremes(int k) {
+    switch (k) {
+    case Integer.MIN_VALUE:
+      return 1;
+    case Integer.MIN_VALUE + 1:
+      return 2;
+    case -1:
+      return 3;
+    case 0:
+      return 4;
+    case 1:
+      return 5;
+    case Integer.MAX_VALUE - 1:
+      return 6;
+    case Integer.MAX_VALUE:
+      return 7;
+    default:
+      return 8;
+    }
+  }
+
   private static void expect(boolean v) {
     if (! v) throw new RuntimeException();
   }
 
-  public static void main(String[] args) {
+  // javac emits a tableswitch for keys which are dense enough for the
+  // JIT to compile a lookupswitch as a table, so we assemble such
+  // lookupswitches ourselves.  The generated method returns
+  // results[i] if its argument equals keys[i] (which must be sorted)
+  // and defaultResult otherwise.
+  private static byte[] makeLookupSwitchCode(List pool,
+                                             int[] keys,
+                                             int[] results,
+                                             int defaultResult)
+    throws IOException
+  {
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    Stream.write2(out, 1); // max stack
+    Stream.write2(out, 1); // max locals
+    Stream.write4(out, 0); // length (we'll set the real value later)
+
+    int n = keys.length;
+    int caseStart = 12 + (n * 8);
+
+    //  0:
+    Stream.write1(out, 0x1a); // iload_0
+    //  1:
+    Stream.write1(out, 0xab); // lookupswitch
+    Stream.write2(out, 0); // padding
+    //  4:
+    Stream.write4(out, caseStart + (n * 4) - 1); // default
+    Stream.write4(out, n);
+    for (int i = 0; i < n; ++i) {
+      Stream.write4(out, keys[i]);
+      Stream.write4(out, caseStart + (i * 4) - 1);
+    }
+
+    for (int i = 0; i < n; ++i) {
+      Stream.write1(out, Assembler.ldc_w);
+      Stream.write2(out, ConstantPool.addInteger(pool, results[i]) + 1);
+      Stream.write1(out, Assembler.ireturn);
+    }
+
+    Stream.write1(out, Assembler.ldc_w);
+    Stream.write2(out, ConstantPool.addInteger(pool, defaultResult) + 1);
+    Stream.write1(out, Assembler.ireturn);
+
+    Stream.write2(out, 0); // exception handler table length
+    Stream.write2(out, 0); // attribute count
+
+    byte[] result = out.toByteArray();
+    Stream.set4(result, 4, result.length - 12);
+
+    return result;
+  }
+
+  private static int lookupSwitchCount = 0;
+
+  private static Method makeLookupSwitch(int[] keys,
+                                         int[] results,
+                                         int defaultResult)
+    throws Exception
+  {
+    List pool = new ArrayList();
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    String name = "$LookupSwitchTest" + (lookupSwitchCount++) + "$";
+
+    Assembler.writeClass
+      (out, pool, ConstantPool.addClass(pool, name),
+       ConstantPool.addClass(pool, "java/lang/Object"),
+       new int[0], new FieldData[0], new MethodData[]
+       { new MethodData(Assembler.ACC_STATIC | Assembler.ACC_PUBLIC,
+                        ConstantPool.addUtf8(pool, "test"),
+                        ConstantPool.addUtf8(pool, "(I)I"),
+                        makeLookupSwitchCode
+                        (pool, keys, results, defaultResult)) });
+
+    return new MyClassLoader(Switch.class.getClassLoader())
+      .defineClass(name, out.toByteArray()).getMethod("test", int.class);
+  }
+
+  private static void expectLookupSwitch(int[] keys, int[] probes)
+    throws Exception
+  {
+    int[] results = new int[keys.length];
+    for (int i = 0; i < keys.length; ++i) {
+      results[i] = (i + 1) * 11;
+    }
+    int defaultResult = -1;
+
+    Method m = makeLookupSwitch(keys, results, defaultResult);
+
+    for (int i = 0; i < keys.length; ++i) {
+      expect((Integer) m.invoke(null, keys[i]) == results[i]);
+    }
+
+    for (int probe: probes) {
+      int expected = defaultResult;
+      for (int i = 0; i < keys.length; ++i) {
+        if (keys[i] == probe) {
+          expected = results[i];
+        }
+      }
+      expect((Integer) m.invoke(null, probe) == expected);
+    }
+  }
+
+  private static void testLookupSwitches() throws Exception {
+    // dense, with gaps and a negative low key:
+    expectLookupSwitch
+      (new int[] { -3, -2, 0, 1, 2, 4, 5, 6, 8, 9 },
+       new int[] { Integer.MIN_VALUE, -5, -4, -3, -1, 0, 3, 7, 9, 10, 11,
+                   Integer.MAX_VALUE });
+
+    // dense, near the extremes:
+    expectLookupSwitch
+      (new int[] { Integer.MIN_VALUE, Integer.MIN_VALUE + 1,
+                   Integer.MIN_VALUE + 3, Integer.MIN_VALUE + 4,
+                   Integer.MIN_VALUE + 5, Integer.MIN_VALUE + 6,
+                   Integer.MIN_VALUE + 7, Integer.MIN_VALUE + 9,
+                   Integer.MIN_VALUE + 10 },
+       new int[] { Integer.MIN_VALUE + 2, Integer.MIN_VALUE + 8,
+                   Integer.MIN_VALUE + 11, -1, 0, Integer.MAX_VALUE });
+
+    expectLookupSwitch
+      (new int[] { Integer.MAX_VALUE - 10, Integer.MAX_VALUE - 9,
+                   Integer.MAX_VALUE - 7, Integer.MAX_VALUE - 6,
+                   Integer.MAX_VALUE - 5, Integer.MAX_VALUE - 4,
+                   Integer.MAX_VALUE - 3, Integer.MAX_VALUE - 1,
+                   Integer.MAX_VALUE },
+       new int[] { Integer.MAX_VALUE - 11, Integer.MAX_VALUE - 8,
+                   Integer.MAX_VALUE - 2, Integer.MIN_VALUE, -1, 0 });
+
+    // sparse:
+    expectLookupSwitch
+      (new int[] { Integer.MIN_VALUE, -100000, -1000, -1, 0, 1, 1000,
+                   100000, 200000, Integer.MAX_VALUE },
+       new int[] { Integer.MIN_VALUE + 1, -999, 2, 999, 1001,
+                   Integer.MAX_VALUE - 1 });
+  }
+
+  public static void main(String[] args) throws Exception {
     expect(table(0) == 0);
     expect(table(9) == 9);
     expect(table(10) == 10);
@@ -62,5 +258,42 @@ public class Switch {
     expect(lookup(47) == -47);
     expect(lookup(245) == 245);
     expect(lookup(246) == 91);
+
+    expect(sparse(-1000000) == 1);
+    expect(sparse(-1000) == 2);
+    expect(sparse(0) == 3);
+    expect(sparse(7) == 4);
+    expect(sparse(1000) == 5);
+    expect(sparse(4096) == 6);
+    expect(sparse(65536) == 7);
+    expect(sparse(1000000) == 8);
+    expect(sparse(123456789) == 9);
+    expect(sparse(8) == 10);
+    expect(sparse(-999) == 10);
+    expect(sparse(Integer.MIN_VALUE) == 10);
+    expect(sparse(Integer.MAX_VALUE) == 10);
+
+    expect(extremes(Integer.MIN_VALUE) == 1);
+    expect(extremes(Integer.MIN_VALUE + 1) == 2);
+    expect(extremes(Integer.MIN_VALUE + 2) == 8);
+    expect(extremes(-1) == 3);
+    expect(extremes(0) == 4);
+    expect(extremes(1) == 5);
+    expect(extremes(2) == 8);
+    expect(extremes(Integer.MAX_VALUE - 2) == 8);
+    expect(extremes(Integer.MAX_VALUE - 1) == 6);
+    expect(extremes(Integer.MAX_VALUE) == 7);
+
+    testLookupSwitches();
+  }
+
+  private static class MyClassLoader extends ClassLoader {
+    public MyClassLoader(ClassLoader parent) {
+      super(parent);
+    }
+
+    public Class defineClass(String name, byte[] bytes) {
+      return super.defineClass(name, bytes, 0, bytes.length);
+    }
   }
 }
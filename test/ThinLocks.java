@@ -0,0 +1,169 @@
+public class ThinLocks {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static int counter;
+
+  private static int lockRecursively(Object o, int depth) {
+    synchronized (o) {
+      expect(Thread.holdsLock(o));
+      return depth == 0 ? 0 : 1 + lockRecursively(o, depth - 1);
+    }
+  }
+
+  private static void waitRecursively(Object o, int depth)
+    throws InterruptedException
+  {
+    synchronized (o) {
+      if (depth == 0) {
+        // waiting inflates the lock, which must adopt the depth we
+        // accumulated while it was thin:
+        o.wait(1);
+      } else {
+        waitRecursively(o, depth - 1);
+      }
+      expect(Thread.holdsLock(o));
+    }
+  }
+
+  private static void expectAvailable(final Object o) throws Exception {
+    expect(! Thread.holdsLock(o));
+
+    final boolean[] acquired = new boolean[1];
+    Thread thread = new Thread() {
+        public void run() {
+          synchronized (o) {
+            acquired[0] = true;
+          }
+        }
+      };
+    thread.start();
+    thread.join();
+
+    expect(acquired[0]);
+  }
+
+  public static void main(String[] args) throws Exception {
+    // recursive locking deeper than any small count field could hold:
+    { Object o = new Object();
+      expect(lockRecursively(o, 1000) == 1000);
+      expectAvailable(o);
+    }
+
+    // inflation while held recursively:
+    { Object o = new Object();
+      waitRecursively(o, 300);
+      expectAvailable(o);
+    }
+
+    // inflation under contention:
+    { final Object lock = new Object();
+      final int iterations = 10000;
+      Thread[] threads = new Thread[4];
+      for (int i = 0; i < threads.length; ++i) {
+        threads[i] = new Thread() {
+            public void run() {
+              for (int j = 0; j < iterations; ++j) {
+                synchronized (lock) {
+                  ++counter;
+                }
+              }
+            }
+          };
+      }
+
+      synchronized (lock) {
+        for (int i = 0; i < threads.length; ++i) {
+          threads[i].start();
+        }
+        // hold the lock long enough for the others to block on it:
+        Thread.sleep(10);
+        expect(counter == 0);
+      }
+
+      for (int i = 0; i < threads.length; ++i) {
+        threads[i].join();
+      }
+
+      synchronized (lock) {
+        expect(counter == threads.length * iterations);
+      }
+      expectAvailable(lock);
+    }
+
+    // wait and notify on a thin-locked object:
+    { final Object o = new Object();
+      final boolean[] ready = new boolean[1];
+
+      synchronized (o) {
+        // nobody waits on a thin lock, so this is a no-op:
+        o.notify();
+        o.notifyAll();
+      }
+
+      Thread thread = new Thread() {
+          public void run() {
+            synchronized (o) {
+              ready[0] = true;
+              o.notifyAll();
+            }
+          }
+        };
+
+      synchronized (o) {
+        thread.start();
+        while (! ready[0]) {
+          o.wait();
+        }
+      }
+      thread.join();
+      expectAvailable(o);
+
+      boolean threw = false;
+      try {
+        o.wait(1);
+      } catch (IllegalMonitorStateException e) {
+        threw = true;
+      }
+      expect(threw);
+
+      threw = false;
+      try {
+        o.notify();
+      } catch (IllegalMonitorStateException e) {
+        threw = true;
+      }
+      expect(threw);
+    }
+
+    // hash codes are unaffected by locking, inflation, and collections
+    // which move locked objects:
+    { Object o = new Object();
+      int hash = o.hashCode();
+      expect(System.identityHashCode(o) == hash);
+
+      synchronized (o) {
+        expect(o.hashCode() == hash);
+        System.gc();
+        expect(Thread.holdsLock(o));
+        expect(o.hashCode() == hash);
+        o.wait(1);
+        expect(o.hashCode() == hash);
+      }
+
+      expect(o.hashCode() == hash);
+      expectAvailable(o);
+
+      Object p = new Object();
+      synchronized (p) {
+        hash = p.hashCode();
+        System.gc();
+        expect(p.hashCode() == hash);
+        expect(Thread.holdsLock(p));
+      }
+      expect(p.hashCode() == hash);
+      expectAvailable(p);
+    }
+  }
+}
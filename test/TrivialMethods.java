@@ -0,0 +1,203 @@
+public class TrivialMethods {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  // The JIT substitutes the bodies of these statically bound getters
+  // and setters for calls to them:
+
+  private static final class Fields {
+    private boolean z;
+    private byte b;
+    private char c;
+    private short s;
+    private int i;
+    private long j;
+    private float f;
+    private double d;
+    private Object o;
+
+    public boolean getZ() { return z; }
+    public byte getB() { return b; }
+    public char getC() { return c; }
+    public short getS() { return s; }
+    public int getI() { return i; }
+    public long getJ() { return j; }
+    public float getF() { return f; }
+    public double getD() { return d; }
+    public Object getO() { return o; }
+
+    public void setZ(boolean v) { z = v; }
+    public void setB(byte v) { b = v; }
+    public void setC(char v) { c = v; }
+    public void setS(short v) { s = v; }
+    public void setI(int v) { i = v; }
+    public void setJ(long v) { j = v; }
+    public void setF(float v) { f = v; }
+    public void setD(double v) { d = v; }
+    public void setO(Object v) { o = v; }
+  }
+
+  private static class Box {
+    private int value;
+
+    private int value() { return value; }
+    private void value(int v) { value = v; }
+
+    public final int finalValue() { return value; }
+    public final void finalValue(int v) { value = v; }
+  }
+
+  private static void fields() {
+    Fields x = new Fields();
+    Object o = new Object();
+
+    x.setZ(true);
+    x.setB((byte) -2);
+    x.setC((char) 0xFFFE);
+    x.setS((short) -3);
+    x.setI(-4);
+    x.setJ(-5L << 40);
+    x.setF(6.5f);
+    x.setD(-7.25);
+    x.setO(o);
+
+    expect(x.getZ());
+    expect(x.getB() == -2);
+    expect(x.getC() == 0xFFFE);
+    expect(x.getS() == -3);
+    expect(x.getI() == -4);
+    expect(x.getJ() == -5L << 40);
+    expect(x.getF() == 6.5f);
+    expect(x.getD() == -7.25);
+    expect(x.getO() == o);
+
+    // the stored reference must be visible to the collector:
+    x.setO(new StringBuilder("foo"));
+    System.gc();
+    expect(x.getO().toString().equals("foo"));
+
+    Box box = new Box();
+    box.value(42);
+    expect(box.value() == 42);
+    box.finalValue(43);
+    expect(box.finalValue() == 43);
+  }
+
+  private static void nullGetters() {
+    Fields x = null;
+    Box box = null;
+
+    try { x.getZ(); expect(false); } catch (NullPointerException e) { }
+    try { x.getB(); expect(false); } catch (NullPointerException e) { }
+    try { x.getC(); expect(false); } catch (NullPointerException e) { }
+    try { x.getS(); expect(false); } catch (NullPointerException e) { }
+    try { x.getI(); expect(false); } catch (NullPointerException e) { }
+    try { x.getJ(); expect(false); } catch (NullPointerException e) { }
+    try { x.getF(); expect(false); } catch (NullPointerException e) { }
+    try { x.getD(); expect(false); } catch (NullPointerException e) { }
+    try { x.getO(); expect(false); } catch (NullPointerException e) { }
+    try { box.value(); expect(false); } catch (NullPointerException e) { }
+    try { box.finalValue(); expect(false); } catch (NullPointerException e) { }
+  }
+
+  private static void nullSetters() {
+    Fields x = null;
+    Box box = null;
+
+    try { x.setZ(true); expect(false); } catch (NullPointerException e) { }
+    try { x.setB((byte) 1); expect(false); } catch (NullPointerException e) { }
+    try { x.setC('c'); expect(false); } catch (NullPointerException e) { }
+    try { x.setS((short) 1); expect(false); } catch (NullPointerException e) { }
+    try { x.setI(1); expect(false); } catch (NullPointerException e) { }
+    try { x.setJ(1L); expect(false); } catch (NullPointerException e) { }
+    try { x.setF(1f); expect(false); } catch (NullPointerException e) { }
+    try { x.setD(1d); expect(false); } catch (NullPointerException e) { }
+    try { x.setO(x); expect(false); } catch (NullPointerException e) { }
+    try { box.value(1); expect(false); } catch (NullPointerException e) { }
+    try { box.finalValue(1); expect(false); } catch (NullPointerException e) { }
+  }
+
+  // Locals written before an inlined accessor faults in a try block
+  // must hold their latest values in the handler:
+  private static int localsInHandler(Box[] boxes) {
+    int count = 0;
+    long sum = 0;
+    try {
+      for (int i = 0; i < boxes.length; ++i) {
+        ++count;
+        sum += boxes[i].value();
+        boxes[i].finalValue(boxes[i].finalValue() + 1);
+      }
+    } catch (NullPointerException e) {
+      expect(sum == (count - 1) * 10);
+      return count;
+    }
+    return -1;
+  }
+
+  // A null receiver in a nested try block is caught by the innermost
+  // handler, and the exception doesn't escape the outer one:
+  private static boolean nested(Fields x) {
+    boolean inner = false;
+    try {
+      try {
+        x.setI(x.getI() + 1);
+      } catch (NullPointerException e) {
+        inner = true;
+      }
+    } catch (NullPointerException e) {
+      expect(false);
+    }
+    return inner;
+  }
+
+  private static int finallyBlock(Box box) {
+    int state = 0;
+    try {
+      try {
+        state = 1;
+        box.value(box.value() + 1);
+        state = 2;
+      } finally {
+        expect(state == (box == null ? 1 : 2));
+        state += 10;
+      }
+    } catch (NullPointerException e) {
+      expect(box == null);
+    }
+    return state;
+  }
+
+  public static void main(String[] args) {
+    for (int i = 0; i < 3; ++i) {
+      fields();
+      nullGetters();
+      nullSetters();
+    }
+
+    { Box[] boxes = new Box[5];
+      for (int i = 0; i < boxes.length; ++i) {
+        if (i != 3) {
+          boxes[i] = new Box();
+          boxes[i].value(10);
+        }
+      }
+      expect(localsInHandler(boxes) == 4);
+      expect(boxes[0].value() == 11 && boxes[2].value() == 11
+             && boxes[4].value() == 10);
+    }
+
+    { Fields x = new Fields();
+      expect(! nested(x));
+      expect(x.getI() == 1);
+      expect(nested(null));
+    }
+
+    { Box box = new Box();
+      expect(finallyBlock(box) == 12);
+      expect(box.value() == 1);
+      expect(finallyBlock(null) == 11);
+    }
+  }
+}
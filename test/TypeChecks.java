@@ -0,0 +1,134 @@
+public class TypeChecks {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class Base { }
+
+  private static class Sub1 extends Base { }
+
+  private static class Sub2 extends Base { }
+
+  private static class Sub3 extends Sub2 { }
+
+  private interface Marker { }
+
+  private static class Marked1 implements Marker { }
+
+  private static class Marked2 extends Base implements Marker { }
+
+  // Each of these methods contains a single checkcast or instanceof
+  // instruction, whose cache remembers the last class it accepted:
+
+  private static Base toBase(Object o) {
+    return (Base) o;
+  }
+
+  private static boolean isBase(Object o) {
+    return o instanceof Base;
+  }
+
+  private static Marker toMarker(Object o) {
+    return (Marker) o;
+  }
+
+  private static boolean isMarker(Object o) {
+    return o instanceof Marker;
+  }
+
+  private static Number[] toNumbers(Object o) {
+    return (Number[]) o;
+  }
+
+  private static void expectToBaseFails(Object o) {
+    try {
+      toBase(o);
+      expect(false);
+    } catch (ClassCastException e) {
+      expect(e.getMessage().equals
+             (o.getClass().getName() + " cannot be cast to TypeChecks$Base"));
+    }
+  }
+
+  private static void expectToMarkerFails(Object o) {
+    try {
+      toMarker(o);
+      expect(false);
+    } catch (ClassCastException e) {
+      expect(e.getMessage().equals
+             (o.getClass().getName()
+              + " cannot be cast to TypeChecks$Marker"));
+    }
+  }
+
+  public static void main(String[] args) {
+    Object base = new Base();
+    Object sub1 = new Sub1();
+    Object sub2 = new Sub2();
+    Object sub3 = new Sub3();
+    Object marked1 = new Marked1();
+    Object marked2 = new Marked2();
+    Object string = "foo";
+
+    // checkcast, alternating between classes which pass, and failing
+    // right after each has been cached:
+    for (int i = 0; i < 3; ++i) {
+      expect(toBase(sub1) == sub1);
+      expectToBaseFails(string);
+      expect(toBase(sub2) == sub2);
+      expectToBaseFails(marked1);
+      expect(toBase(sub1) == sub1);
+      expect(toBase(sub3) == sub3);
+      expectToBaseFails(string);
+      expect(toBase(base) == base);
+      expect(toBase(marked2) == marked2);
+      expectToBaseFails(new Object());
+      expect(toBase(null) == null);
+    }
+
+    // instanceof likewise:
+    for (int i = 0; i < 3; ++i) {
+      expect(isBase(sub1));
+      expect(! isBase(string));
+      expect(isBase(sub2));
+      expect(! isBase(marked1));
+      expect(isBase(sub1));
+      expect(! isBase(null));
+      expect(isBase(sub3));
+      expect(! isBase(new Object()));
+      expect(isBase(marked2));
+    }
+
+    // interfaces:
+    for (int i = 0; i < 3; ++i) {
+      expect(toMarker(marked1) == marked1);
+      expectToMarkerFails(sub1);
+      expect(toMarker(marked2) == marked2);
+      expectToMarkerFails(base);
+      expect(toMarker(null) == null);
+
+      expect(isMarker(marked1));
+      expect(! isMarker(sub1));
+      expect(isMarker(marked2));
+      expect(! isMarker(base));
+    }
+
+    // arrays:
+    { Object integers = new Integer[] { 1 };
+      Object longs = new Long[] { 2L };
+      Object objects = new Object[] { 3 };
+      for (int i = 0; i < 3; ++i) {
+        expect(toNumbers(integers) == integers);
+        try {
+          toNumbers(objects);
+          expect(false);
+        } catch (ClassCastException e) { }
+        expect(toNumbers(longs) == longs);
+        try {
+          toNumbers(new int[1]);
+          expect(false);
+        } catch (ClassCastException e) { }
+      }
+    }
+  }
+}
@@ -82,3 +82,72 @@ TEST(ArchitecturePlan)
     assertNotEqual(static_cast<uint64_t>(0), (uint64_t)mask.lowRegisterMask);
   }
 }
+
+TEST(CompareAndSwap)
+{
+  BasicEnv env;
+  Asm a(env);
+
+  bool thunk;
+  OperandMask expectedMask;
+  OperandMask newValueMask;
+  env.arch->planCompareAndSwap(
+      vm::TargetBytesPerWord, expectedMask, newValueMask, &thunk);
+  assertFalse(thunk);
+  assertEqual(static_cast<uint64_t>(1),
+              (uint64_t)expectedMask.lowRegisterMask);
+  assertFalse(newValueMask.lowRegisterMask.contains(Register(0)));
+
+  // lock cmpxchg %ecx,8(%edi), or %rcx,8(%rdi) on x86_64:
+  lir::Memory dst(Register(7), 8);
+  lir::RegisterPair expected(Register(0));
+  lir::RegisterPair newValue(Register(1));
+  a.a->compareAndSwap(vm::TargetBytesPerWord, &dst, &expected, &newValue);
+
+  a.a->endBlock(false)->resolve(0, 0);
+
+  uint8_t code[8];
+  a.a->setDestination(code);
+  a.a->write();
+
+  const uint8_t expectedCode64[] = {0xf0, 0x48, 0x0f, 0xb1, 0x4f, 0x08};
+  const uint8_t expectedCode32[] = {0xf0, 0x0f, 0xb1, 0x4f, 0x08};
+  const uint8_t* expectedCode
+      = vm::TargetBytesPerWord == 8 ? expectedCode64 : expectedCode32;
+  unsigned expectedLength = vm::TargetBytesPerWord == 8
+                                ? sizeof(expectedCode64)
+                                : sizeof(expectedCode32);
+
+  assertEqual(expectedLength, a.a->length());
+  for (unsigned i = 0; i < expectedLength; ++i) {
+    assertEqual(expectedCode[i], code[i]);
+  }
+}
+
+TEST(ByteSwap)
+{
+  BasicEnv env;
+  Asm a(env);
+
+  bool thunk;
+  OperandMask mask;
+  env.arch->planSource(lir::ByteSwap, 4, mask, 4, &thunk);
+  assertFalse(thunk);
+  assertTrue(env.arch->alwaysCondensed(lir::ByteSwap));
+
+  // bswap %ecx:
+  lir::RegisterPair r(Register(1));
+  a.a->apply(lir::ByteSwap,
+             OperandInfo(4, lir::Operand::Type::RegisterPair, &r),
+             OperandInfo(4, lir::Operand::Type::RegisterPair, &r));
+
+  a.a->endBlock(false)->resolve(0, 0);
+
+  uint8_t code[4];
+  a.a->setDestination(code);
+  a.a->write();
+
+  assertEqual(2u, a.a->length());
+  assertEqual(static_cast<uint8_t>(0x0f), code[0]);
+  assertEqual(static_cast<uint8_t>(0xc9), code[1]);
+}
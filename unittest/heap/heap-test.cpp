@@ -0,0 +1,470 @@
+/* Copyright (c) 2008-2015, Avian Contributors
+
+   Permission to use, copy, modify, and/or distribute this software
+   for any purpose with or without fee is hereby granted, provided
+   that the above copyright notice and this permission notice appear
+   in all copies.
+
+   There is NO WARRANTY for this software.  See license.txt for
+   details. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "avian/common.h"
+#include <avian/heap/heap.h>
+#include <avian/system/system.h>
+
+#include "test-harness.h"
+
+using namespace vm;
+
+namespace {
+
+// objects in this test look like this:
+//
+//   [header] [field count] [id] [field 0] ... [field n - 1] [hash?]
+//
+// where the header is the address of TypeWord plus a two-bit mark,
+// as in the VM proper.
+
+const unsigned CountOffset = 1;
+const unsigned IdOffset = 2;
+const unsigned FieldsOffset = 3;
+
+const uintptr_t HashTakenMark = 1;
+const uintptr_t ExtendedMark = 2;
+
+const unsigned ObjectCount = 20000;
+const unsigned MaxFields = 3;
+const unsigned RootInterval = 10;
+
+uintptr_t TypeWord;
+
+uintptr_t* word(void* o)
+{
+  return static_cast<uintptr_t*>(o);
+}
+
+unsigned baseSize(void* o)
+{
+  return FieldsOffset + word(o)[CountOffset];
+}
+
+class MyClient : public Heap::Client {
+ public:
+  MyClient(Heap* heap, void** roots, unsigned rootCount)
+      : heap(heap), roots(roots), rootCount(rootCount)
+  {
+  }
+
+  virtual void collect(void*, Heap::CollectionType)
+  {
+  }
+
+  virtual void visitRoots(Heap::Visitor* v)
+  {
+    for (unsigned i = 0; i < rootCount; ++i) {
+      v->visit(roots + i);
+    }
+
+    heap->postVisit();
+  }
+
+  virtual bool isFixed(void*)
+  {
+    return false;
+  }
+
+  virtual unsigned sizeInWords(void* p)
+  {
+    void* o = heap->follow(maskAlignedPointer(p));
+    return baseSize(o) + ((word(o)[0] & ~PointerMask) == ExtendedMark);
+  }
+
+  virtual unsigned copiedSizeInWords(void* p, uintptr_t header)
+  {
+    return baseSize(p) + ((header & ~PointerMask) != 0);
+  }
+
+  virtual void copy(void* src, void* dst, uintptr_t header)
+  {
+    uintptr_t mark = header & ~PointerMask;
+    unsigned base = baseSize(src);
+
+    memcpy(dst, src, (base + (mark == ExtendedMark)) * BytesPerWord);
+
+    if (mark == HashTakenMark) {
+      word(dst)[0] = (header & PointerMask) | ExtendedMark;
+      word(dst)[base] = reinterpret_cast<uintptr_t>(src) / BytesPerWord;
+    } else {
+      word(dst)[0] = header;
+    }
+  }
+
+  virtual void walk(void* p, Heap::Walker* w)
+  {
+    void* o = heap->follow(maskAlignedPointer(p));
+    for (unsigned i = 0; i < word(o)[CountOffset]; ++i) {
+      if (not w->visit(FieldsOffset + i)) {
+        break;
+      }
+    }
+  }
+
+  Heap* heap;
+  void** roots;
+  unsigned rootCount;
+};
+
+// builds a pseudo-random object graph in a nursery allocated from the
+// heap, lets the heap collect it several times, and verifies that the
+// graph survives intact
+class Graph {
+ public:
+  Graph(unsigned collectorCount)
+      : s(makeSystem()),
+        heap(makeHeap(s, 64 * 1024 * 1024, collectorCount)),
+        client(heap, roots, ObjectCount / RootInterval),
+        seed(42)
+  {
+    heap->setClient(&client);
+    memset(roots, 0, sizeof(roots));
+  }
+
+  ~Graph()
+  {
+    heap->dispose();
+    s->dispose();
+  }
+
+  unsigned random()
+  {
+    seed = (seed * 1103515245) + 12345;
+    return (seed >> 16) & 0x7FFF;
+  }
+
+  void* makeObject(uintptr_t*& nursery, unsigned id, unsigned fieldCount)
+  {
+    uintptr_t* o = nursery;
+    nursery += FieldsOffset + fieldCount;
+
+    o[0] = reinterpret_cast<uintptr_t>(&TypeWord);
+    if (id % 7 == 0) {
+      // the object will need an extra word to hold its hash code
+      // when it is copied:
+      o[0] |= HashTakenMark;
+      heap->pad(o);
+    }
+    o[CountOffset] = fieldCount;
+    o[IdOffset] = id;
+
+    return o;
+  }
+
+  // allocates ObjectCount new objects, each referring to some of the
+  // ones allocated before it, replaces the roots with a subset of
+  // them, and then collects
+  void populate(unsigned generation)
+  {
+    unsigned capacity = ObjectCount * (FieldsOffset + MaxFields);
+    uintptr_t* start = static_cast<uintptr_t*>(
+        heap->allocate(capacity * BytesPerWord));
+    uintptr_t* nursery = start;
+
+    void** objects = static_cast<void**>(
+        heap->allocate(ObjectCount * BytesPerWord));
+
+    for (unsigned i = 0; i < ObjectCount; ++i) {
+      unsigned id = (generation * ObjectCount) + i;
+      unsigned fieldCount = i ? random() % (MaxFields + 1) : 0;
+      void* o = makeObject(nursery, id, fieldCount);
+
+      for (unsigned j = 0; j < fieldCount; ++j) {
+        unsigned target = random() % i;
+        word(o)[FieldsOffset + j]
+            = reinterpret_cast<uintptr_t>(objects[target]);
+        children[id % ObjectCount][j] = (generation * ObjectCount) + target;
+      }
+
+      objects[i] = o;
+    }
+
+    for (unsigned i = 0; i < ObjectCount / RootInterval; ++i) {
+      roots[i] = objects[(i * RootInterval) + (random() % RootInterval)];
+    }
+
+    heap->free(objects, ObjectCount * BytesPerWord);
+
+    heap->collect(Heap::MinorCollection, nursery - start, 0);
+
+    heap->free(start, capacity * BytesPerWord);
+  }
+
+  // sets the card covering the specified object the way compiled code
+  // would, falling back to Heap::mark outside the table
+  void markCard(void* o)
+  {
+    Heap::CardTable* table = heap->cardTable();
+    uintptr_t i = (reinterpret_cast<uintptr_t>(o) - table->start)
+                  >> LogCardSizeInBytes;
+    if (i < table->count) {
+      table->cards[i] = 1;
+    } else {
+      heap->mark(o, FieldsOffset, 1);
+    }
+  }
+
+  // stores a reference to a new object into each of the (possibly
+  // tenured) roots, using the card table as the write barrier
+  void storeIntoRoots(unsigned id)
+  {
+    unsigned count = ObjectCount / RootInterval;
+    unsigned capacity = count * FieldsOffset;
+    uintptr_t* start = static_cast<uintptr_t*>(
+        heap->allocate(capacity * BytesPerWord));
+    uintptr_t* nursery = start;
+
+    for (unsigned i = 0; i < count; ++i) {
+      void* root = roots[i];
+      if (root and word(root)[CountOffset]) {
+        void* o = makeObject(nursery, id + i, 0);
+        word(root)[FieldsOffset] = reinterpret_cast<uintptr_t>(o);
+        markCard(root);
+        stored[i] = id + i;
+      } else {
+        stored[i] = 0;
+      }
+    }
+
+    heap->collect(Heap::MinorCollection, nursery - start, 0);
+
+    heap->free(start, capacity * BytesPerWord);
+  }
+
+  // returns the sum of the ids (plus one) of all objects reachable
+  // from the roots (counting each once per path), or zero if the
+  // graph is inconsistent
+  uint64_t check(void* o, unsigned depth)
+  {
+    o = maskAlignedPointer(o);
+
+    uintptr_t mark = word(o)[0] & ~PointerMask;
+    if ((word(o)[0] & PointerMask) != reinterpret_cast<uintptr_t>(&TypeWord)
+        or mark == HashTakenMark) {
+      return 0;
+    }
+
+    unsigned id = word(o)[IdOffset];
+    if ((id % 7 == 0) != (mark == ExtendedMark)) {
+      return 0;
+    }
+
+    uint64_t sum = id + 1;
+    if (depth) {
+      for (unsigned i = 0; i < word(o)[CountOffset]; ++i) {
+        uint64_t n = check(reinterpret_cast<void*>(word(o)[FieldsOffset + i]),
+                           depth - 1);
+        if (n == 0) {
+          return 0;
+        }
+        sum += n;
+      }
+    }
+    return sum;
+  }
+
+  uint64_t check()
+  {
+    uint64_t sum = 0;
+    for (unsigned i = 0; i < ObjectCount / RootInterval; ++i) {
+      if (roots[i] == 0) {
+        continue;
+      }
+
+      uint64_t n = check(roots[i], 4);
+      if (n == 0) {
+        return 0;
+      }
+      sum += n;
+    }
+    return sum;
+  }
+
+  bool checkChildren(unsigned generation)
+  {
+    for (unsigned i = 0; i < ObjectCount / RootInterval; ++i) {
+      void* o = roots[i];
+      if (o == 0) {
+        continue;
+      }
+
+      unsigned id = word(o)[IdOffset];
+      if (id / ObjectCount == generation) {
+        unsigned count = word(o)[CountOffset];
+        for (unsigned j = 0; j < count; ++j) {
+          void* child = reinterpret_cast<void*>(word(o)[FieldsOffset + j]);
+          if (word(child)[IdOffset] != children[id % ObjectCount][j]) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // clears every other root, leaving garbage scattered throughout
+  // whichever generation the objects currently live in
+  void dropRoots()
+  {
+    for (unsigned i = 1; i < ObjectCount / RootInterval; i += 2) {
+      roots[i] = 0;
+    }
+  }
+
+  // enough minor collections to tenure everything which survived
+  // the first one
+  void tenure()
+  {
+    for (unsigned i = 0; i < TenureThreshold + 2; ++i) {
+      heap->collect(Heap::MinorCollection, 0, 0);
+    }
+  }
+
+  bool checkStored()
+  {
+    for (unsigned i = 0; i < ObjectCount / RootInterval; ++i) {
+      if (stored[i] and roots[i]) {
+        void* child = reinterpret_cast<void*>(word(roots[i])[FieldsOffset]);
+        if (word(child)[IdOffset] != stored[i]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  System* s;
+  Heap* heap;
+  void* roots[ObjectCount / RootInterval];
+  MyClient client;
+  unsigned children[ObjectCount][MaxFields];
+  unsigned stored[ObjectCount / RootInterval];
+  uint32_t seed;
+};
+
+uint64_t collect(unsigned collectorCount, bool* consistent)
+{
+  Graph* g = new Graph(collectorCount);
+
+  *consistent = true;
+  g->populate(0);
+  *consistent = *consistent and g->checkChildren(0);
+
+  // enough minor collections to tenure everything which survived
+  // the first one:
+  for (unsigned i = 0; i < TenureThreshold + 2; ++i) {
+    g->heap->collect(Heap::MinorCollection, 0, 0);
+    *consistent = *consistent and g->checkChildren(0);
+  }
+
+  g->storeIntoRoots(ObjectCount * 2);
+  *consistent = *consistent and g->checkStored();
+
+  g->heap->collect(Heap::MinorCollection, 0, 0);
+  *consistent = *consistent and g->checkStored();
+
+  g->heap->collect(Heap::MajorCollection, 0, 0);
+  *consistent = *consistent and g->checkStored();
+
+  uint64_t sum = g->check();
+
+  delete g;
+
+  return sum;
+}
+
+uint64_t collectInPlace(unsigned collectorCount, bool* consistent)
+{
+  Graph* g = new Graph(collectorCount);
+
+  g->populate(0);
+  g->tenure();
+  g->dropRoots();
+
+  // this should leave holes in gen2 which the next generation of
+  // tenured objects will fill:
+  g->heap->collect(Heap::MajorCollection, 0, 0);
+  *consistent = g->check() != 0 and g->checkChildren(0);
+
+  g->populate(1);
+  g->tenure();
+  *consistent = *consistent and g->check() != 0 and g->checkChildren(1);
+
+  g->storeIntoRoots(ObjectCount * 3);
+  *consistent = *consistent and g->checkStored();
+
+  g->dropRoots();
+  g->heap->collect(Heap::MajorCollection, 0, 0);
+  g->heap->collect(Heap::MinorCollection, 0, 0);
+  *consistent = *consistent and g->checkStored();
+
+  uint64_t sum = g->check();
+
+  delete g;
+
+  return sum;
+}
+
+}  // namespace
+
+TEST(SerialMinorCollection)
+{
+  bool consistent;
+  assertNotEqual(static_cast<uint64_t>(0), collect(1, &consistent));
+  assertTrue(consistent);
+}
+
+TEST(ParallelMinorCollection)
+{
+  bool consistent;
+  uint64_t expected = collect(1, &consistent);
+  assertTrue(consistent);
+
+  for (unsigned i = 0; i < 4; ++i) {
+    assertEqual(expected, collect(4, &consistent));
+    assertTrue(consistent);
+  }
+}
+
+TEST(InPlaceMajorCollection)
+{
+  bool consistent;
+  uint64_t expected = collectInPlace(1, &consistent);
+  assertNotEqual(static_cast<uint64_t>(0), expected);
+  assertTrue(consistent);
+
+  assertEqual(expected, collectInPlace(4, &consistent));
+  assertTrue(consistent);
+}
+
+TEST(LargeHeapLimit)
+{
+  if (sizeof(void*) == 8) {
+    System* s = makeSystem();
+    size_t limit = static_cast<size_t>(16) * 1024 * 1024 * 1024;
+    Heap* heap = makeHeap(s, limit);
+
+    assertEqual(limit, heap->limit());
+    assertEqual(limit, heap->remaining());
+    assertFalse(heap->limitExceeded());
+
+    void* p = heap->allocate(1024);
+    assertTrue(heap->remaining() <= limit - 1024);
+    heap->free(p, 1024);
+    assertEqual(limit, heap->remaining());
+
+    heap->dispose();
+    s->dispose();
+  }
+}